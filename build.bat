@@ -79,7 +79,7 @@ popd
 
 echo compiling source code...
 
-set compilerFlags=
+set compilerFlags=-O2
 rem -g -Wvarargs -Wall -Werror
 set includeFlags=-Isrc/ -Isrc/core/ -Isrc/dasm/ -Isrc/linker/ -Isrc/cmd/
 rem -I./thirdparty/include/
@@ -1,6 +1,18 @@
 output=bin/ysicxe
 includes=-Isrc/*/
 
-flags="--std=c++17"
+flags="--std=c++17 -O2 -pthread"
 
-g++ $includes $flags src/*.cpp src/*/*.cpp -o $output
\ No newline at end of file
+g++ $includes $flags src/*.cpp src/*/*.cpp -o $output || exit 1
+
+# ./build.sh test: fixture checks (test/run.sh)
+if [ "$1" = "test" ]; then
+    test/run.sh || exit 1
+fi
+
+# ./build.sh bench [size] [files]: corpus generator + end-to-end timings
+if [ "$1" = "bench" ]; then
+    g++ $flags tools/objgen.cpp -o bin/objgen || exit 1
+    shift
+    tools/bench.sh "$@"
+fi
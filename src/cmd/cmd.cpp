@@ -23,33 +23,48 @@ ylib::CommandInfo ylib::parse_cli(std::vector<std::string> arguments, std::vecto
     std::vector<std::string> cmdIn;
 
     // parse the arguments first.
-    std::vector<std::string> usedArgs;
+    // a lone '-' is a value (stdin/stdout), not an option
+    auto isOption = [](const std::string &arg) { return arg.size() > 1 && arg[0] == '-'; };
+
+    std::vector<bool> used(args.size(), false);
     for(usize i = 0; i < args.size(); i++)
     {
         // ex: Proj1 --config-file ./YMake.toml -C
-        if(args[i][0] == '-')
+        if(isOption(args[i]))
         {
+            // --name=value: the value is attached, not the next arg
+            std::string opt = args[i];
+            size_t eq = opt.find('=');
+            bool attached = eq != std::string::npos;
+            if(attached)
+                opt = opt.substr(0, eq);
+
             // found an arg.
             bool found = false;
             for(CommandArgument &arg : calledCmd.args)
             {
                 // looking for it in the options for the command.
-                if(args[i] == arg.shortOpt || args[i] == arg.longOpt)
+                if(opt == arg.shortOpt || opt == arg.longOpt)
                 {
                     // found it!
                     found = true;
-                    if(arg.valType == ValueType::BOOL || arg.valType == ValueType::NONE)
+                    if(attached)
+                    {
+                        foundAvailableArgs[arg.name] = args[i].substr(eq + 1);
+                        used[i] = true;
+                    }
+                    else if(arg.valType == ValueType::BOOL || arg.valType == ValueType::NONE)
                     {
                         // no need to check the other args.
                         foundAvailableArgs[arg.name] = "NULL";
-                        usedArgs.push_back(args[i]);
+                        used[i] = true;
                     }
-                    else if((i + 1) < args.size() && args[i + 1][0] != '-')
+                    else if((i + 1) < args.size() && !isOption(args[i + 1]))
                     {
                         // need to check the next val.
                         foundAvailableArgs[arg.name] = args[i + 1];
-                        usedArgs.push_back(args[i]);
-                        usedArgs.push_back(args[i + 1]);
+                        used[i] = true;
+                        used[i + 1] = true;
                         i++;
                     }
                     else
@@ -73,21 +88,14 @@ ylib::CommandInfo ylib::parse_cli(std::vector<std::string> arguments, std::vecto
     // parse the std in.
     for(usize i = 0; i < args.size(); i++)
     {
-        bool used = false;
-        for(auto arg : usedArgs)
-        {
-            if(args[i] == arg)
-            {
-                used = true;
-            }
-        }
-
-        if(!used)
+        if(!used[i])
         {
             cmdIn.push_back(args[i]);
         }
     }
 
+    // the loops would only feed compiled out trace calls
+#if LOG_MAX_LEVEL >= LOG_TRACE
     LTRACE(true, BLUE_TEXT("COMMAND INPUT: \n"));
     for(auto entry : cmdIn)
     {
@@ -99,6 +107,7 @@ ylib::CommandInfo ylib::parse_cli(std::vector<std::string> arguments, std::vecto
     {
         LTRACE(true, "\tkey: ", k, "\tval: ", v, "\n");
     }
+#endif
 
     CommandInfo info = {
         .cmd       = calledCmd,
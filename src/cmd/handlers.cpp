@@ -5,13 +5,211 @@
 
 #include "../dasm/dasm.h"
 #include "../linker/linker.h"
+#include "../vm/vm.h"
 
-#include <iomanip>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <set>
 
 namespace sic::cli {
 
+// decimal count argument (threads, jobs...)
+template<typename T = u32>
+static T parse_count(const string &value, const string &flag) {
+    string str = sic::trim(value);
+
+    T count = 0;
+    auto res = std::from_chars(str.data(), str.data() + str.size(), count);
+    if (res.ec != std::errc() || res.ptr != str.data() + str.size()) {
+        throw ylib::Error("invalid value for " + flag + ": '" + str + "'");
+    }
+
+    return count;
+}
+
+// --stats (text) or --stats=json, "" when not asked for
+static string stats_mode(map<string, string> &args) {
+    if (!args.count("stats")) return "";
+
+    string mode = sic::trim(args["stats"]);
+    if (mode == "NULL" || mode == "text") return "text";
+    if (mode == "json") return mode;
+
+    throw ylib::Error("invalid value for --stats: '" + mode + "' (text or json)");
+}
+
+// json is one object per line, for whatever collects them
+static void print_stats(const string &mode, const string &tool, const vector<string> &inputs,
+                        const sic::run_stats &stats) {
+    if (mode == "json") {
+        LLOG(stats.to_json(tool, inputs), "\n")
+        return;
+    }
+
+    string names;
+    for (const auto &input : inputs) names += (names.empty() ? "" : ", ") + input;
+
+    LOGFMT("STATS", tool, " ", names, "\n", stats.to_text())
+}
+
+// --batch source: a directory (every *.obj in it) or a list file (one path per line)
+static vector<string> collect_batch_inputs(const string &source) {
+    namespace fs = std::filesystem;
+    vector<string> files;
+
+    std::error_code ec;
+    if (fs::is_directory(source, ec)) {
+        for (const auto &entry : fs::directory_iterator(source, ec)) {
+            if (entry.is_regular_file(ec) && entry.path().extension() == ".obj") {
+                files.push_back(entry.path().string());
+            }
+        }
+
+        if (ec) {
+            throw ylib::Error("DASM: couldn't read batch directory " + source + ": " + ec.message());
+        }
+
+        // directory order is arbitrary, keep runs reproducible
+        std::sort(files.begin(), files.end());
+    }
+    else {
+        ifstream list(source);
+        if (!list.is_open()) {
+            throw ylib::Error("DASM: couldn't open batch list " + source);
+        }
+
+        string line;
+        while (getline(list, line)) {
+            line = sic::trim(line);
+            if (!line.empty() && line[0] != '#') {
+                files.push_back(line);
+            }
+        }
+    }
+
+    if (files.empty()) {
+        throw ylib::Error("DASM: no object files found in " + source);
+    }
+
+    return files;
+}
+
+// disassembles a whole corpus in one process, one file per pool task.
+// every file gets <out-dir>/<name>.asm and <out-dir>/<name>.sym, a file that
+// fails is reported at the end and doesn't stop the others
+static void handle_dasm_batch(map<string, string> &args) {
+    namespace fs = std::filesystem;
+
+    vector<string> files = collect_batch_inputs(sic::trim(args["batch"]));
+
+    string out_dir = ".";
+    if (args.count("outdir")) {
+        out_dir = sic::trim(args["outdir"]);
+    }
+
+    std::error_code ec;
+    fs::create_directories(out_dir, ec);
+    if (ec) {
+        throw ylib::Error("DASM: couldn't create output directory " + out_dir + ": " + ec.message());
+    }
+
+    u32 jobs = 0; // all cores
+    if (args.count("jobs")) {
+        jobs = parse_count(args["jobs"], "--jobs");
+    }
+
+    u32 threads = 1;
+    if (args.count("threads")) {
+        threads = parse_count(args["threads"], "--threads");
+    }
+
+    bool recursive = args.count("recursive") > 0;
+    string stats = stats_mode(args);
+
+    // failure message per file (empty = ok), each task only touches its own slot
+    vector<string> errors(files.size());
+    vector<sic::run_stats> file_stats(files.size());
+
+    // two inputs with the same name would overwrite each other's output
+    vector<string> out_base(files.size());
+    std::set<string> taken;
+    for (usize i = 0; i < files.size(); i++) {
+        out_base[i] = (fs::path(out_dir) / fs::path(files[i]).stem()).string();
+        if (!taken.insert(out_base[i]).second) {
+            errors[i] = "output name clashes with another input: " + out_base[i] + ".asm";
+        }
+    }
+
+    // the opcode table is only read from here on, all tasks share it
+    thread_pool pool(std::min<usize>(jobs ? jobs : thread_pool::default_threads(), files.size()));
+
+    pool.parallel_for(files.size(), [&](usize i) {
+        if (!errors[i].empty()) return;
+
+        try {
+            sic::dasm tool(files[i], out_base[i] + ".asm", out_base[i] + ".sym");
+            tool.set_quiet(true);
+            tool.set_threads(threads);
+            tool.set_recursive(recursive);
+            tool.run();
+
+            file_stats[i] = tool.get_stats();
+        }
+        catch (ylib::Error &err) {
+            errors[i] = err.what();
+        }
+        catch (std::exception &err) {
+            errors[i] = err.what();
+        }
+    });
+
+    // per file, so a pathological input stands out
+    if (!stats.empty()) {
+        for (usize i = 0; i < files.size(); i++) {
+            if (errors[i].empty()) print_stats(stats, "dasm", {files[i]}, file_stats[i]);
+        }
+    }
+
+    usize failed = 0;
+    for (usize i = 0; i < files.size(); i++) {
+        if (errors[i].empty()) continue;
+
+        failed++;
+        LOGFMT("DASM", RED_TEXT("failed: "), files[i], "\n\t", errors[i])
+    }
+
+    if (!failed) {
+        LOGFMT(
+            "DASM",
+            GREEN_TEXT("batch disassembly successful!\n"),
+            "\t", files.size(), " files, output saved to: ", out_dir, "\n"
+        )
+    }
+    else {
+        LOGFMT(
+            "DASM",
+            YELLOW_TEXT("batch finished with errors\n"),
+            "\t", files.size() - failed, "/", files.size(), " files ok, output saved to: ", out_dir, "\n"
+        )
+
+        throw ylib::Error("DASM: " + std::to_string(failed) + " of " + std::to_string(files.size()) + " files failed");
+    }
+}
+
 void handle_dasm(vector<string> &cmdIn, map<string, string> &args) {
 
+    // custom instruction set (before any file is decoded, batch mode shares it)
+    if (args.count("opcodes")) {
+        op::load_instructions(sic::trim(args["opcodes"]));
+    }
+
+    // corpus mode
+    if (args.count("batch")) {
+        handle_dasm_batch(args);
+        return;
+    }
+
     // handle input file (obj)
     string input_file;
     if (args.count("input")) {
@@ -30,8 +228,8 @@ void handle_dasm(vector<string> &cmdIn, map<string, string> &args) {
         output_file = args["output"];
     }
 
-    // symtab file
-    string symtab_file = "out.sym";
+    // symtab file (streaming to stdout appends it to the listing by default)
+    string symtab_file = sic::trim(output_file) == "-" ? "-" : "out.sym";
     if (args.count("symtab")) {
         symtab_file = args["symtab"];
     }
@@ -43,7 +241,28 @@ void handle_dasm(vector<string> &cmdIn, map<string, string> &args) {
 
     // run dasm
     sic::dasm tool(input_file, output_file, symtab_file);
+
+    if (args.count("threads")) {
+        tool.set_threads(parse_count(args["threads"], "--threads"));
+    }
+
+    if (args.count("recursive")) {
+        // the traversal jumps around the whole image, a stream is gone by then
+        if (input_file == "-" || output_file == "-") {
+            throw ylib::Error("DASM: --recursive needs the whole image, it can't be used with '-' (streaming)");
+        }
+        tool.set_recursive(true);
+    }
+
+    tool.set_quiet(args.count("quiet") > 0);
+
+    string stats = stats_mode(args);
+
     tool.run();
+
+    if (!stats.empty()) {
+        print_stats(stats, "dasm", {input_file}, tool.get_stats());
+    }
 }
 
 void handle_linker(vector<string> &cmdIn, map<string, string> &args) {
@@ -89,17 +308,134 @@ void handle_linker(vector<string> &cmdIn, map<string, string> &args) {
         start_addr = base::hextobin<u32>(addr_str);
     }
 
+    if (args.count("threads")) {
+        tool.set_threads(parse_count(args["threads"], "--threads"));
+    }
+
+    // output layout (checked before linking, not after)
+    sic::image_format format = sic::image_format::raw;
+    if (args.count("format")) {
+        string name = sic::trim(args["format"]);
+
+        if (name == "seg" || name == "segmented") format = sic::image_format::segmented;
+        else if (name == "sparse") format = sic::image_format::sparse;
+        else if (name != "raw") {
+            throw ylib::Error("Linker: unknown output format '" + name + "' (raw, seg or sparse)");
+        }
+    }
+
+    if (args.count("mmap") && args.count("output")) {
+        if (format != sic::image_format::raw) {
+            throw ylib::Error("Linker: --mmap only builds the raw format");
+        }
+
+        tool.map_output(sic::trim(args["output"]));
+    }
+
+    if (args.count("cache")) {
+        tool.set_cache(sic::trim(args["cache"]));
+    }
+
+    tool.set_quiet(args.count("quiet") > 0);
+
+    string stats = stats_mode(args);
+
     // run the linker
     tool.run(start_addr);
 
     // output
     if (args.count("output")) {
-        tool.write_memory_to_file(sic::trim(args["output"]));
+        tool.write_memory_to_file(sic::trim(args["output"]), format);
     }
 
     if (args.count("export")) {
         tool.write_estab_to_file(sic::trim(args["export"]));
     }
+
+    if (!stats.empty()) {
+        print_stats(stats, "link", files_to_link, tool.get_stats());
+    }
+}
+
+void handle_run(vector<string> &cmdIn, map<string, string> &args) {
+    string input_file;
+    if (args.count("input")) {
+        input_file = sic::trim(args["input"]);
+    }
+    else if (!cmdIn.empty()) {
+        input_file = sic::trim(cmdIn[0]);
+    }
+    else {
+        throw ylib::Error("VM: No image specified. Use -i <file> or pass the filename directly.");
+    }
+
+    sic::vm machine;
+    u32 entry = machine.load_image(input_file);
+
+    // an explicit entry wins over the one in a seg header
+    if (args.count("entry")) {
+        entry = base::hextobin<u32>(sic::trim(args["entry"]));
+    }
+
+    if (args.count("steps")) {
+        machine.set_max_steps(parse_count<u64>(args["steps"], "--max-steps"));
+    }
+
+    u32 hot = 10;
+    if (args.count("hot")) {
+        hot = parse_count(args["hot"], "--hot");
+    }
+    machine.set_profile(hot > 0);
+
+    auto start = std::chrono::steady_clock::now();
+    sic::vm_stop stop = machine.run(entry);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const char *reason = "";
+    switch (stop) {
+        case sic::vm_stop::halted:     reason = "halted (J *)"; break;
+        case sic::vm_stop::returned:   reason = "returned (RSUB)"; break;
+        case sic::vm_stop::step_limit: reason = "step limit reached"; break;
+        case sic::vm_stop::fault:      reason = "fault"; break;
+        default: break;
+    }
+
+    u64 steps = machine.get_steps();
+    double mips = secs > 0 ? steps / secs / 1e6 : 0;
+
+    // one buffer per column, filled in place (no streams)
+    char hex[16];
+    auto hex6 = [&hex](u32 val) { return string(hex, base::format_hex(hex, val, 6)); };
+
+    string regs;
+    const std::pair<const char *, sic::vm_reg> shown[] = {
+        {"A", sic::REG_A}, {"X", sic::REG_X}, {"L", sic::REG_L}, {"B", sic::REG_B},
+        {"S", sic::REG_S}, {"T", sic::REG_T}, {"PC", sic::REG_PC}, {"SW", sic::REG_SW},
+    };
+    for (const auto &[name, reg] : shown) {
+        regs += string(name) + "=" + hex6(machine.get_reg(reg)) + " ";
+    }
+
+    char num[64];
+    snprintf(num, sizeof(num), "F=%g", machine.get_freg());
+    regs += num;
+
+    snprintf(num, sizeof(num), "%.3fs, %.1f MIPS", secs, mips);
+
+    LOGFMT("VM", reason, " after ", steps, " instructions (", num, ")\n\t", regs, "\n")
+
+    if (hot > 0) {
+        string lines;
+        for (const auto &[addr, count] : machine.hot_addresses(hot)) {
+            lines += "\t" + hex6(addr) + "  " + std::to_string(count) + "\n";
+        }
+
+        LOGFMT("VM", "hot addresses:\n", lines)
+    }
+
+    if (stop == sic::vm_stop::fault) {
+        throw ylib::Error("VM: " + machine.get_fault() + " at " + hex6(machine.get_fault_addr()));
+    }
 }
 
 } // namespace sic::cli
\ No newline at end of file
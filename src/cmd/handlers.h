@@ -10,4 +10,7 @@ void handle_dasm(std::vector<std::string> &cmdIn, std::map<std::string, std::str
 // callback for 'link' command
 void handle_linker(std::vector<std::string> &cmdIn, std::map<std::string, std::string> &args);
 
+// callback for 'run' command
+void handle_run(std::vector<std::string> &cmdIn, std::map<std::string, std::string> &args);
+
 } // namespace sic::cli
\ No newline at end of file
@@ -13,8 +13,8 @@ namespace ylib {
 class Error
 {
     private:
-    const char *message;
-    const u32 code;
+    string message; // owned, errors are often built from temporary strings
+    u32 code;
 
     public:
     Error(const char *message)
@@ -23,16 +23,16 @@ class Error
     }
 
     Error(string msg)
-        : message{msg.c_str()}, code{YLIB_ERR_UNKNOWN}
+        : message{msg}, code{YLIB_ERR_UNKNOWN}
     {
     }
 
     Error(const u32 code, const char *message)
-        : code{code}, message{message}
+        : message{message}, code{code}
     {
     }
 
-    const char *what() const { return message; }
+    const char *what() const { return message.c_str(); }
     const u32 errcode() const { return code; }
 };
 
@@ -6,4 +6,139 @@ OutputType Logger::outType = (OutputType)LOG_CONSOLE;
 std::string Logger::filePath = LOG_DEFAULT_FILE;
 std::ofstream Logger::fileStream;
 
-std::mutex Logger::mut;
\ No newline at end of file
+std::mutex Logger::mut;
+
+LogRing Logger::ring;
+std::thread Logger::writer;
+std::once_flag Logger::started;
+std::condition_variable Logger::wake;
+std::atomic<bool> Logger::sleeping {false};
+std::atomic<size_t> Logger::written {0};
+bool Logger::stopping = false;
+std::atomic<bool> Logger::stopped {false};
+
+// last static of this file: destroyed first, the ring and the streams are still there
+static struct LogShutdown
+{
+    ~LogShutdown() { Logger::Shutdown(); }
+} logShutdown;
+
+void Logger::Push(std::string text, OutputType out)
+{
+    // after shutdown (other static destructors) there's no one to hand it to
+    if(stopped.load(std::memory_order_acquire))
+    {
+        LOCK_MUTEX(mut);
+        Write(text, out);
+        std::cout.flush();
+        return;
+    }
+
+    std::call_once(started, [] { writer = std::thread(Run); });
+
+    // full: the writer is behind, wait for a free slot
+    while(!ring.TryPush(text, out))
+    {
+        wake.notify_one();
+        std::this_thread::yield();
+    }
+
+    if(sleeping.load())
+    {
+        LOCK_MUTEX(mut);
+        wake.notify_one();
+    }
+}
+
+void Logger::Flush()
+{
+    if(!writer.joinable())
+        return;
+
+    size_t target = ring.Pushed();
+    while(written.load(std::memory_order_acquire) < target)
+    {
+        wake.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+void Logger::Shutdown()
+{
+    if(!writer.joinable())
+        return;
+
+    {
+        LOCK_MUTEX(mut);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    stopped.store(true, std::memory_order_release);
+
+    // whatever came in while it was stopping
+    std::string text;
+    OutputType out;
+    while(ring.TryPop(text, out))
+        Write(text, out);
+    std::cout.flush();
+
+    if(fileStream.is_open())
+        fileStream.close();
+}
+
+void Logger::Write(const std::string &text, OutputType out)
+{
+    if(out == OutputType::CONSOLE || out == OutputType::ALL)
+        std::cout.write(text.data(), text.size());
+
+    if(out == OutputType::FILE || out == OutputType::ALL)
+    {
+        if(!fileStream.is_open())
+            fileStream.open(filePath, std::ios::app);
+
+        fileStream << text;
+    }
+}
+
+void Logger::Run()
+{
+    std::string text;
+    OutputType out;
+
+    while(true)
+    {
+        bool wrote = false;
+        while(ring.TryPop(text, out))
+        {
+            Write(text, out);
+            wrote = true;
+        }
+
+        if(wrote)
+        {
+            std::cout.flush();
+            if(fileStream.is_open())
+                fileStream.flush();
+
+            written.store(ring.Popped(), std::memory_order_release);
+        }
+
+        std::unique_lock<std::mutex> lock(mut);
+
+        // a push between the last pop and here sees sleeping set and wakes us
+        sleeping.store(true);
+        if(!ring.Empty())
+        {
+            sleeping.store(false);
+            continue;
+        }
+
+        if(stopping)
+            break;
+
+        wake.wait_for(lock, std::chrono::milliseconds(50));
+        sleeping.store(false);
+    }
+}
@@ -9,7 +9,10 @@
 #include <string.h>
 #include <cstdlib>
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 #define LOCK_MUTEX(x) std::lock_guard<std::mutex> lock(x)
 
 #include <chrono>
@@ -58,6 +61,17 @@ using std::chrono::system_clock;
 #define LOG_ALL     3
 
 #define LOG_DEFAULT_FILE "log.txt"
+
+// build-time threshold: calls above this level expand to nothing, their arguments are
+// never evaluated. build with -DLOG_MAX_LEVEL=LOG_INFO to get debug/trace output back
+// (then Logger::priority still filters at run time)
+#ifndef LOG_MAX_LEVEL
+    #define LOG_MAX_LEVEL LOG_WARN
+#endif
+
+// messages waiting for the writer thread (power of 2)
+#define LOG_RING_SIZE 1024
+
 #define __FILENAME__     (strstr(__FILE__, "src") ? strstr(__FILE__, "src") + 3 : __FILE__)
 #define FILE_INFO        __FILENAME__, __LINE__
 #define NO_FILE_INFO     nulllptr, nullptr
@@ -74,24 +88,34 @@ using std::chrono::system_clock;
 
 #define LOG_CHANGE_PRIORITY(x) Logger::priority = (LogLevel)x;
 
+#if LOG_MAX_LEVEL >= LOG_FATAL
 #define LFATAL(x...)                                                                                                   \
     {                                                                                                                  \
         LOGINIT();                                                                                                     \
         LOGINFO(LOG_FATAL, __FILENAME__, __LINE__)                                                                     \
         log.Log(info, x);                                                                                              \
     }
+#else
+#define LFATAL(x...) {}
+#endif
 
+#if LOG_MAX_LEVEL >= LOG_ERROR
 #define LERROR(x...)                                                                                                   \
     {                                                                                                                  \
         LOGINIT();                                                                                                     \
         LOGINFO(LOG_FATAL, __FILENAME__, __LINE__)                                                                     \
         log.Log(info, x);                                                                                              \
     }
+#else
+#define LERROR(x...) {}
+#endif
 
+#if LOG_MAX_LEVEL >= LOG_WARN
 #define LWARN(x, y...)                                                                                                 \
     {                                                                                                                  \
         LOGINIT();                                                                                                     \
-        if(x)                                                                                                          \
+        if(!Logger::Enabled((LogLevel)LOG_WARN)) {}                                                                    \
+        else if(x)                                                                                                     \
         {                                                                                                              \
             LOGINFO(LOG_WARN, __FILENAME__, __LINE__)                                                                  \
             log.Log(info, y);                                                                                          \
@@ -102,11 +126,16 @@ using std::chrono::system_clock;
             log.Log(info, y);                                                                                          \
         }                                                                                                              \
     }
+#else
+#define LWARN(x, y...) {}
+#endif
 
+#if LOG_MAX_LEVEL >= LOG_DEBUG
 #define LDEBUG(x, y...)                                                                                                \
     {                                                                                                                  \
         LOGINIT();                                                                                                     \
-        if(x)                                                                                                          \
+        if(!Logger::Enabled((LogLevel)LOG_DEBUG)) {}                                                                   \
+        else if(x)                                                                                                     \
         {                                                                                                              \
             LOGINFO(LOG_DEBUG, __FILENAME__, __LINE__)                                                                 \
             log.Log(info, y);                                                                                          \
@@ -117,11 +146,16 @@ using std::chrono::system_clock;
             log.Log(info, y);                                                                                          \
         }                                                                                                              \
     }
+#else
+#define LDEBUG(x, y...) {}
+#endif
 
+#if LOG_MAX_LEVEL >= LOG_TRACE
 #define LTRACE(x, y...)                                                                                                \
     {                                                                                                                  \
         LOGINIT();                                                                                                     \
-        if(x)                                                                                                          \
+        if(!Logger::Enabled((LogLevel)LOG_TRACE)) {}                                                                   \
+        else if(x)                                                                                                     \
         {                                                                                                              \
             LOGINFO(LOG_TRACE, __FILENAME__, __LINE__)                                                                 \
             log.Log(info, y);                                                                                          \
@@ -132,11 +166,16 @@ using std::chrono::system_clock;
             log.Log(info, y);                                                                                          \
         }                                                                                                              \
     }
+#else
+#define LTRACE(x, y...) {}
+#endif
 
+#if LOG_MAX_LEVEL >= LOG_INFO
 #define LINFO(x, y...)                                                                                                 \
     {                                                                                                                  \
         LOGINIT();                                                                                                     \
-        if(x)                                                                                                          \
+        if(!Logger::Enabled((LogLevel)LOG_INFO)) {}                                                                    \
+        else if(x)                                                                                                     \
         {                                                                                                              \
             LOGINFO(LOG_INFO, __FILENAME__, __LINE__)                                                                  \
             log.Log(info, y);                                                                                          \
@@ -147,6 +186,9 @@ using std::chrono::system_clock;
             log.Log(info, y);                                                                                          \
         }                                                                                                              \
     }
+#else
+#define LINFO(x, y...) {}
+#endif
 
 #define LASSERT(x, y)                                                                                                  \
     {                                                                                                                  \
@@ -203,7 +245,87 @@ struct LogInfo
     std::string linenumber;
 };
 
+//___________________ LOG RING _____________________
+// bounded lock-free queue of formatted messages: every slot has a sequence number that
+// says whose turn it is (push or pop). any thread pushes, only the writer thread pops.
+class LogRing
+{
+    private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        std::string text;
+        OutputType out;
+    };
+
+    Slot slots[LOG_RING_SIZE];
+    alignas(64) std::atomic<size_t> head {0}; // next slot to push to
+    alignas(64) std::atomic<size_t> tail {0}; // next slot to pop (written by the writer only)
+
+    public:
+    LogRing()
+    {
+        for(size_t i = 0; i < LOG_RING_SIZE; i++)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // false if the ring is full. text is swapped in (the caller gets an old buffer back)
+    bool TryPush(std::string &text, OutputType out)
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            Slot &slot = slots[pos & (LOG_RING_SIZE - 1)];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+
+            if(seq == pos)
+            {
+                if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.text.swap(text);
+                    slot.out = out;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if((ptrdiff_t)(seq - pos) < 0)
+                return false;
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    // writer thread only
+    bool TryPop(std::string &text, OutputType &out)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot &slot = slots[pos & (LOG_RING_SIZE - 1)];
+
+        if(slot.seq.load(std::memory_order_acquire) != pos + 1)
+            return false;
+
+        text.swap(slot.text);
+        out = slot.out;
+        slot.seq.store(pos + LOG_RING_SIZE, std::memory_order_release);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        return slots[pos & (LOG_RING_SIZE - 1)].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // slots handed out so far / popped so far
+    size_t Pushed() const { return head.load(std::memory_order_acquire); }
+    size_t Popped() const { return tail.load(std::memory_order_acquire); }
+};
+
 //___________________ LOGGER CLASS _____________________
+// Log() formats on the calling thread and pushes the text into the ring, a background
+// thread writes it out. nothing on the hot path takes a lock or touches a stream.
 class Logger
 {
     private:
@@ -212,6 +334,16 @@ class Logger
 
     static std::mutex mut;
 
+    // writer thread
+    static LogRing ring;
+    static std::thread writer;
+    static std::once_flag started;
+    static std::condition_variable wake;
+    static std::atomic<bool> sleeping;
+    static std::atomic<size_t> written; // messages out of the ring and flushed
+    static bool stopping; // guarded by mut
+    static std::atomic<bool> stopped;
+
     public:
     static LogLevel priority;
     static OutputType outType;
@@ -219,6 +351,7 @@ class Logger
     private:
     static inline void EnableFileOutput(std::string filepath = LOG_DEFAULT_FILE)
     {
+        Flush(); // the writer thread owns the stream
         if(filepath.size() != 0)
             filePath = filepath;
 
@@ -230,6 +363,7 @@ class Logger
 
     static inline void DisableFileOutput()
     {
+        Flush();
         if(fileStream.is_open())
             fileStream.close();
     }
@@ -379,109 +513,48 @@ class Logger
         Logger::priority = (LogLevel) ll;
     }
 
+    static inline bool Enabled(LogLevel level)
+    {
+        if(level > Logger::priority || Logger::outType == OutputType::NONE)
+            return false;
+
+        return !(Logger::priority == LogLevel::INFO_ONLY && level < LogLevel::INFO);
+    }
+
     template<typename Arg, typename... Args>
     void Log(LogInfo info, Arg&& arg, Args&&... args)
     {
-        LOCK_MUTEX(mut);
-        std::stringstream out;
-
-        if(info.level > Logger::priority)
+        if(!Enabled(info.level))
             return;
 
-        if(Logger::priority == LogLevel::INFO_ONLY && info.level < LogLevel::INFO)
-            return;
+        std::stringstream out;
 
-        switch(Logger::outType)
+        if(info.level != LogLevel::NONE)
         {
-        case OutputType::NONE:
-            return;
-        case OutputType::CONSOLE:
-            if(info.level != LogLevel::NONE)
-            {
-                if(info.filename != "")
-                    out << GetFullHeader(info.level, true, info.filename, info.linenumber);
-                else
-                    out << GetFullHeader(info.level, true);
-            }
-
-            out << std::forward<Arg>(arg);
-            using expander = int[];
-            (void) expander{0, (void(out << std::forward<Args>(args)), 0)...};
-
-            std::cout << out.str();
-            break;
-
-        case OutputType::FILE:
-            if(info.level != LogLevel::NONE)
-            {
-                if(info.filename != "")
-                    out << GetFullHeader(info.level, true, info.filename, info.linenumber);
-                else
-                    out << GetFullHeader(info.level, true);
-            }
-
-            out << std::forward<Arg>(arg);
-            using expander = int[];
-            (void) expander{0, (void(out << std::forward<Args>(args)), 0)...};
-
-            if(fileStream.is_open())
-                fileStream << out.str();
+            if(info.filename != "")
+                out << GetFullHeader(info.level, true, info.filename, info.linenumber);
             else
-            {
-                fileStream.open(filePath, std::ios::app);
-                fileStream << out.str();
-            }
-
-            break;
-
-        case OutputType::ALL:
-            // console
-            if(info.level != LogLevel::NONE)
-            {
-                if(info.filename != "")
-                    out << GetFullHeader(info.level, true, info.filename, info.linenumber);
-                else
-                    out << GetFullHeader(info.level, true);
-            }
+                out << GetFullHeader(info.level, true);
+        }
 
-            out << std::forward<Arg>(arg);
-            using expander = int[];
-            (void) expander{0, (void(out << std::forward<Args>(args)), 0)...};
+        out << std::forward<Arg>(arg);
+        using expander = int[];
+        (void) expander{0, (void(out << std::forward<Args>(args)), 0)...};
 
-            std::cout << out.str();
+        Push(out.str(), Logger::outType);
+    }
+    // clang-format on
 
-            out.str(std::string());
+    // hands a message to the writer thread (blocks only while the ring is full)
+    static void Push(std::string text, OutputType out);
 
-            // file
-            std::stringstream out; 
-            if(info.level != LogLevel::NONE)
-            {
-                if(info.filename != "")
-                    out << GetFullHeader(info.level, true, info.filename, info.linenumber);
-                else
-                    out << GetFullHeader(info.level, true);
-            }
+    // returns once everything logged so far is written (call before writing to stdout directly)
+    static void Flush();
 
-            out << std::forward<Arg>(arg);
-            using expander = int[];
-            (void) expander{0, (void(out << std::forward<Args>(args)), 0)...};
-            
-            if(fileStream.is_open())
-                fileStream << out.str();
-            else
-            {
-                fileStream.open(filePath, std::ios::app);
-                fileStream << out.str();
-            }
-            
-            break;
-        }
-    }
-    // clang-format on
+    // drains the ring and stops the writer thread (at exit)
+    static void Shutdown();
 
-    ~Logger()
-    {
-        if(fileStream.is_open())
-            fileStream.close();
-    }
+    private:
+    static void Write(const std::string &text, OutputType out);
+    static void Run();
 };
\ No newline at end of file
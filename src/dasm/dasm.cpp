@@ -1,5 +1,36 @@
 #include "dasm.h"
 
+// decimal, zero padded to at least width digits. out needs 10 chars
+static char *format_dec(char *out, u32 val, i32 width = 1) {
+    char digits[10];
+    i32 n = 0;
+
+    do {
+        digits[n++] = '0' + val % 10;
+        val /= 10;
+    } while(val);
+
+    while(n < width) digits[n++] = '0';
+    while(n > 0) *out++ = digits[--n];
+
+    return out;
+}
+
+// label name: REF + the id, at least 4 digits. out needs 13 chars
+static char *format_label(char *out, u32 id) {
+    memcpy(out, "REF", 3);
+    return format_dec(out + 3, id, 4);
+}
+
+static std::string_view mnemonic_of(const sic::asmline &line) {
+    switch(line.kind) {
+        case sic::operand_kind::data_byte: return "BYTE";
+        case sic::operand_kind::resw:      return "RESW";
+        case sic::operand_kind::resb:      return "RESB";
+        default:                           return op::instr_table[line.opcode].mnemonic;
+    }
+}
+
 // constructor
 sic::dasm::dasm(string objfile, string asmfile, string symtabfile) {
     locctr = 0;
@@ -11,30 +42,37 @@ sic::dasm::dasm(string objfile, string asmfile, string symtabfile) {
 // main dasm function
 void sic::dasm::run() {
 
-    // hide cursor in terminal
-    cli::init_progress_bar();
+    // a pipe on either side: decode and write as the records come in
+    if(objfile == "-" || asmfile == "-") {
+        run_streaming();
+        return;
+    }
+
+    // batch mode: many of these run at once, the terminal is not ours
+    progress.start(quiet);
 
     // phase 1: loader
     // read HTE recs and fill memory map
-    cli::draw_progress(0, 30, "loading obj file...");
-
+    stats.begin("load");
     process_obj_file();
 
     // phase 2: disassembler
     // iterate through memory map, handle gaps, and decode instructions
-    cli::draw_progress(30, 70, "decoding instructions...");
-
+    stats.begin("decode");
     disassemble();
 
     // phase 3: saving
     // write the formatted assembly to a file
-    cli::draw_progress(70, 100, "writing to file(s)");
-
+    stats.begin("write");
     write_asm_to_file();
     write_symtab_to_file();
 
-    // reset terminal
-    cli::reset_terminal();
+    finish_stats();
+
+    // final state + terminal back to normal
+    progress.stop();
+
+    if(quiet) return;
 
     LOGFMT(
         "DASM",
@@ -44,200 +82,677 @@ void sic::dasm::run() {
 }
 
 void sic::dasm::disassemble() {
-    u32 curr = start_addr;
+    u32 start = start_addr;
     u32 end = start_addr + prog_len;
 
     // reset dasm state
     assembly.clear();
-    symtab.clear();
+    label_ids.clear();
+    labels.clear();
     label_counter = 0; // count from zero, hehe
 
-    while(curr < end) {
+    // follow the code from the entry point, whatever it never reaches is data
+    if(recursive) {
+        progress.phase("tracing code...", end - start);
+        trace_code(start, end);
+        assign_labels();
+        return;
+    }
+
+    // 1. cut the covered runs into independent chunks
+    vector<decode_chunk> chunks = split_chunks(start, end);
+
+    u64 to_decode = 0;
+    for(const auto &chunk : chunks) to_decode += chunk.end - chunk.start;
+    progress.phase("decoding instructions...", to_decode);
+
+    // 2. decode every chunk on its own (decoding only reads the memory map)
+    if(threads > 1 && chunks.size() > 1) {
+        thread_pool pool(std::min<usize>(threads, chunks.size()));
+        pool.parallel_for(chunks.size(), [&](usize i) { decode_chunk_lines(chunks[i]); });
+    }
+    else {
+        for(auto &chunk : chunks) decode_chunk_lines(chunk);
+    }
+
+    // 3. stitch the chunks back together in address order, with the holes as resw/resb
+    merge_chunks(chunks, start, end);
+
+    // 4. name the referenced addresses in listing order (keeps REFxxxx numbering stable)
+    assign_labels();
+}
+
+void sic::dasm::run_streaming() {
+    // reading, decoding and writing are interleaved, it's all one phase
+    stats.begin("stream");
+
+    // reset dasm state
+    assembly.clear();
+    label_ids.clear();
+    labels.clear();
+    label_counter = 0;
+    prog_name.clear();
+    start_addr = prog_len = 0;
+    memory.clear();
+    coverage.clear();
+    mem_limit = 0;
+
+    std::unique_ptr<file_writer> out;
+    if(asmfile == "-") {
+        Logger::Flush(); // log lines go before the listing, not into it
+        out = std::make_unique<file_writer>(stdout, "stdout");
+    }
+    else out = std::make_unique<file_writer>(asmfile);
+
+    stream_state state;
+
+    if(objfile == "-") {
+        stream_record_reader reader(stdin);
+        stream_records(reader, *out, state);
+    }
+    else {
+        mapped_file file(objfile);
+        record_reader reader(file.view());
+        stream_records(reader, *out, state);
+    }
+
+    // no more records: whatever is left is final
+    if(!state.header_written) {
+        write_listing_header(*out);
+    }
+    emit_stream_lines(*out, state, true);
+    write_listing_footer(*out);
+
+    // the symtab goes after the listing, or to its own file
+    sort_labels();
+
+    if(symtabfile == "-") {
+        write_symtab(*out);
+    }
+    else {
+        write_symtab_to_file();
+    }
 
-        // case: gap exists (resw/resb)
-        if(curr < is_initialized.size() && !is_initialized[curr]) {
-            asmline gapline;
-            gapline.address = curr;
+    out->close();
+
+    finish_stats();
+}
 
-            // calc gap size
-            u32 gap_start = curr;
-            while(curr < end && !is_initialized[curr]) {
-                curr++;
+template<typename reader_t>
+void sic::dasm::stream_records(reader_t &reader, file_writer &out, stream_state &state) {
+    record rec;
+
+    while(reader.next(rec)) {
+        char rec_type = rec.type();
+        count_record(rec_type);
+
+        if(rec_type == 'H') {
+            process_header(rec);
+
+            state.curr = start_addr;
+            state.settled = start_addr;
+            state.frontier = start_addr;
+
+            write_listing_header(out);
+            state.header_written = true;
+        }
+        else if(rec_type == 'T') {
+            u32 addr = base::hextobin<u32>(rec.field(1, 6));
+
+            // lines that were already written depended on these bytes
+            if(addr < state.settled) {
+                throw ylib::Error("DASM: streaming needs T records in address order, record at " +
+                                  string(rec.field(1, 6)) + " goes back into written output");
             }
-            u32 size = curr - gap_start;
-            gapline.len = size;
-
-            // heuristic to determine resw or resb (innacurate)
-            if(size % 3 == 0) {
-                gapline.inst.mnemonic = "RESW";
-                gapline.operand = std::to_string(size / 3);
-            } else {
-                gapline.inst.mnemonic = "RESB";
-                gapline.operand = std::to_string(size);
+
+            process_text(rec);
+
+            // T records come in address order: nothing below this one changes anymore
+            state.frontier = std::max(state.frontier, addr);
+            emit_stream_lines(out, state, false);
+        }
+        else if(rec_type == 'E') {
+            process_end(rec);
+            break; // just stop if you read E
+        }
+    }
+}
+
+void sic::dasm::emit_stream_lines(file_writer &out, stream_state &state, bool final) {
+    u32 end = start_addr + prog_len;
+
+    if(!final && !state.header_written) return;
+
+    while(state.curr < end) {
+        u32 curr = state.curr;
+        if(!final && curr >= state.frontier) break;
+
+        usize run = coverage.find(curr);
+        bool covered = run < coverage.size() && coverage[run].start <= curr;
+
+        if(covered) {
+            // the decoder reads up to 4 bytes, all of them have to be final
+            if(!final && (u64)curr + 4 > state.frontier) break;
+
+            asmline line = decode_instruction(curr);
+            if(line.kind == operand_kind::memory) {
+                line.value = get_label(line.value);
             }
 
-            gapline.objcode = ""; // no object code generated
-            assembly.push_back(gapline);
-            continue;
+            // only labels referenced so far can show up here, the symtab has all of them
+            write_listing_line(out, line, label_ids.find(curr));
+
+            state.curr = curr + std::max(line.len, 1u);
+            state.settled = std::max(state.settled, curr + 4);
+        }
+        else {
+            // case: gap (resw/resb) -> it lasts until the next run, which has to be known
+            if(!final && (run == coverage.size() || coverage[run].start > state.frontier)) break;
+
+            u32 gap_end = run < coverage.size() ? std::min(coverage[run].start, end) : end;
+
+            write_listing_line(out, gap_line(curr, gap_end), label_ids.find(curr));
+
+            state.curr = gap_end;
+            state.settled = std::max(state.settled, gap_end);
         }
+    }
+
+    // everything below curr is written: give the memory back
+    memory.release_below(state.curr);
+    coverage.drop_before(state.curr);
+}
+
+vector<sic::dasm::decode_chunk> sic::dasm::split_chunks(u32 start, u32 end) const {
+    vector<decode_chunk> chunks;
+
+    // sequential: one chunk per run. parallel: small enough pieces to keep every
+    // thread busy, big enough that the resync at each cut stays noise
+    u64 chunk_size = ~0U;
+    if(threads > 1) {
+        chunk_size = std::max<u64>(memory_image::PAGE_SIZE, coverage.covered() / (threads * 8));
+    }
 
-        // case: instruction
+    for(usize run = coverage.find(start); run < coverage.size(); run++) {
+        u32 run_start = std::max(coverage[run].start, start);
+        u32 run_end = std::min(coverage[run].end, end);
+
+        if(run_start >= end) break;
+
+        for(u32 cut = run_start; cut < run_end;) {
+            u32 cut_end = (u32)std::min<u64>(run_end, (u64)cut + chunk_size);
+            chunks.push_back({cut, cut_end, {}});
+            cut = cut_end;
+        }
+    }
+
+    return chunks;
+}
+
+void sic::dasm::decode_chunk_lines(decode_chunk &chunk) const {
+    // the last instruction may hang over the end of the chunk
+    u32 curr = chunk.start;
+    u32 reported = chunk.start;
+
+    while(curr < chunk.end) {
         asmline line = decode_instruction(curr);
+        chunk.lines.push_back(line);
+
+        // advance
+        curr += std::max(line.len, 1u);
+
+        if(curr - reported >= PROGRESS_STEP) {
+            progress.advance(curr - reported);
+            reported = curr;
+        }
+    }
+
+    progress.advance(std::max(curr, chunk.end) - reported);
+}
 
-        // handling symbols
-        if(line.is_mem_ref) {
-            // get label (or create a new one)
-            string label_name = get_label(line.target_address);
-            line.operand += label_name;
+void sic::dasm::merge_chunks(vector<decode_chunk> &chunks, u32 start, u32 end) {
+    u32 curr = start;
+
+    for(auto &chunk : chunks) {
+        vector<asmline> &lines = chunk.lines;
+
+        // case: gap exists (resw/resb) -> it lasts until this chunk
+        if(curr < chunk.start) {
+            push_gap(curr, chunk.start);
+            curr = chunk.start;
+        }
+
+        // the previous chunk ran over all of this one
+        if(curr >= chunk.end) continue;
+
+        // the previous chunk's last instruction hung into this one, so the chunk
+        // was decoded from the wrong place: decode from where we really are until
+        // we land on an instruction start the chunk also found (from there on
+        // both decodings are the same)
+        usize i = 0;
+        while(i < lines.size() && lines[i].address < curr) i++;
+
+        while(curr < chunk.end && (i == lines.size() || lines[i].address != curr)) {
+            asmline line = decode_instruction(curr);
+            assembly.push_back(line);
+            curr += std::max(line.len, 1u);
+
+            while(i < lines.size() && lines[i].address < curr) i++;
         }
 
-        // handle {X} placeholder (for indexed)
-        if(line.indexed) {
-            line.operand += ", X";
+        if(i == lines.size()) continue;
+
+        const asmline &last = lines.back();
+        curr = last.address + std::max(last.len, 1u);
+
+        assembly.insert(assembly.end(), std::make_move_iterator(lines.begin() + i),
+                        std::make_move_iterator(lines.end()));
+        lines.clear();
+    }
+
+    // trailing reserved space
+    if(curr < end) push_gap(curr, end);
+}
+
+void sic::dasm::assign_labels() {
+    // only ids here, the names are rendered by the writers
+    for(auto &line : assembly) {
+        if(line.kind == operand_kind::memory) {
+            // get label (or create a new one), the target address isn't needed after this
+            line.value = get_label(line.value);
         }
+    }
+
+    sort_labels();
+}
+
+void sic::dasm::sort_labels() {
+    // sorted copy for the writers, they walk it alongside the listing
+    labels.clear();
+    labels.reserve(label_ids.size());
+    label_ids.for_each([this](u32 addr, u32 id) { labels.push_back({addr, id}); });
+
+    std::sort(labels.begin(), labels.end(),
+              [](const label_entry &a, const label_entry &b) { return a.address < b.address; });
+}
+
+// what an instruction does to the control flow (recursive traversal)
+enum class flow_kind : u8 {
+    next,   // falls through
+    jump,   // J: goes to its target only
+    branch, // JEQ/JGT/JLT: target or fall through
+    call,   // JSUB: target, then comes back to the next instruction
+    ret,    // RSUB: doesn't fall through
+};
+
+// flow kind per opcode, by mnemonic so custom tables (--opcodes) work too
+static std::array<flow_kind, 256> make_flow_table() {
+    std::array<flow_kind, 256> flows{};
+
+    for(usize opc = 0; opc < 256; opc++) {
+        std::string_view name = op::instr_table[opc].mnemonic;
+
+        if(name == "J") flows[opc] = flow_kind::jump;
+        else if(name == "JEQ" || name == "JGT" || name == "JLT") flows[opc] = flow_kind::branch;
+        else if(name == "JSUB") flows[opc] = flow_kind::call;
+        else if(name == "RSUB") flows[opc] = flow_kind::ret;
+    }
+
+    return flows;
+}
+
+void sic::dasm::trace_code(u32 start, u32 end) {
+    std::array<flow_kind, 256> flows = make_flow_table();
+
+    vector<asmline> traced_lines;  // every decoded line, block by block
+    vector<code_block> blocks;
+    flat_map<u32, u32> block_at;   // start address -> index into blocks (the cache)
+    interval_set code;             // bytes that belong to a decoded instruction
+
+    // addresses execution can reach, waiting to be decoded
+    vector<u32> worklist;
+
+    // the E record entry (locctr), or the start if it points outside the image
+    u32 entry = locctr;
+    if(entry < start || entry >= end || !coverage.contains(entry)) entry = start;
+    worklist.push_back(entry);
+
+    // is [addr, addr + len) decodable: loaded, inside the program, not part of another instruction
+    auto is_free = [&](u32 addr, u32 len) {
+        if(addr < start || (u64)addr + len > end) return false;
+
+        usize run = coverage.find(addr);
+        if(run == coverage.size() || coverage[run].start > addr || coverage[run].end < addr + len) return false;
+
+        usize taken = code.find(addr);
+        return taken == code.size() || code[taken].start >= addr + len;
+    };
+
+    // only targets we can actually compute are followed
+    auto follow = [&](const asmline &line) {
+        if(line.kind != operand_kind::memory) return;
+        if(line.flags & (LINE_INDIRECT | LINE_INDEXED | LINE_BASE_REL)) return;
+
+        worklist.push_back(line.value);
+    };
+
+    while(!worklist.empty()) {
+        u32 addr = worklist.back();
+        worklist.pop_back();
+
+        // decoded already (or it lands inside another instruction)
+        if(block_at.find(addr) || !is_free(addr, 1)) continue;
+
+        code_block block{addr, addr, traced_lines.size(), 0};
+        u32 curr = addr;
+
+        while(true) {
+            asmline line = decode_instruction(curr);
+
+            // not an instruction, or overlapping one we already have: the block ends here
+            if(line.kind == operand_kind::data_byte || line.len == 0 || !is_free(curr, line.len)) break;
+
+            traced_lines.push_back(line);
+            curr += line.len;
+
+            flow_kind flow = flows[line.opcode];
+            if(flow == flow_kind::next) continue;
+
+            // control flow: the block ends after this instruction
+            if(flow != flow_kind::ret) follow(line);
+            if(flow == flow_kind::branch || flow == flow_kind::call) worklist.push_back(curr);
+            break;
+        }
+
+        block.end = curr;
+        block.count = traced_lines.size() - block.first;
+
+        // nothing decodable at addr: leave it to the data pass
+        if(block.count == 0) continue;
+
+        code.add(block.start, block.end);
+        block_at.insert(block.start, (u32)blocks.size());
+        progress.advance(block.end - block.start);
+        blocks.push_back(block);
+    }
+
+    // listing order
+    std::sort(blocks.begin(), blocks.end(),
+              [](const code_block &a, const code_block &b) { return a.start < b.start; });
+
+    // code blocks, data around them, holes as resw/resb
+    u32 curr = start;
+    usize next_block = 0;
+
+    while(curr < end) {
+        if(next_block < blocks.size() && blocks[next_block].start == curr) {
+            const code_block &block = blocks[next_block++];
+            assembly.insert(assembly.end(), traced_lines.begin() + block.first,
+                            traced_lines.begin() + block.first + block.count);
+            curr = block.end;
+            continue;
+        }
+
+        u32 stop = next_block < blocks.size() ? blocks[next_block].start : end;
+
+        usize run = coverage.find(curr);
+        if(run < coverage.size() && coverage[run].start <= curr) {
+            // loaded but never reached: data
+            u32 data_end = std::min(coverage[run].end, stop);
+            emit_data(curr, data_end);
+            curr = data_end;
+        }
+        else {
+            // case: gap exists (resw/resb) -> it lasts until the next run
+            u32 gap_end = run < coverage.size() ? std::min(coverage[run].start, stop) : stop;
+            push_gap(curr, gap_end);
+            curr = gap_end;
+        }
+    }
+}
+
+void sic::dasm::emit_data(u32 data_start, u32 data_end) {
+    // word sized BYTE lines (the listing has room for 4 bytes of object code)
+    for(u32 addr = data_start; addr < data_end;) {
+        asmline line{};
+        line.address = addr;
+        line.len = std::min<u32>(3, data_end - addr);
+        line.kind = operand_kind::data_byte;
 
         assembly.push_back(line);
+        addr += line.len;
+    }
+}
 
-        // advance
-        curr += std::max(line.len, (i32)1);
+void sic::dasm::push_gap(u32 gap_start, u32 gap_end) {
+    assembly.push_back(gap_line(gap_start, gap_end));
+}
+
+sic::asmline sic::dasm::gap_line(u32 gap_start, u32 gap_end) {
+    asmline gapline{};
+    gapline.address = gap_start;
+
+    // calc gap size
+    u32 size = gap_end - gap_start;
+    gapline.len = size;
+
+    // heuristic to determine resw or resb (innacurate)
+    if(size % 3 == 0) {
+        gapline.kind = operand_kind::resw;
+        gapline.value = size / 3;
+    } else {
+        gapline.kind = operand_kind::resb;
+        gapline.value = size;
     }
+
+    // no object code generated
+    return gapline;
 }
 
 void sic::dasm::write_asm_to_file() {
-    ofstream out(asmfile);
+    file_writer out(asmfile);
+    progress.phase("writing to file(s)", assembly.size());
+
+    write_listing_header(out);
+
+    // labels and lines are both sorted by address: one cursor instead of a lookup per line
+    usize next_label = 0;
+    usize written = 0;
+
+    for(const auto &line : assembly) {
+        // labels pointing inside an instruction are skipped
+        while (next_label < labels.size() && labels[next_label].address < line.address)
+            next_label++;
+
+        const u32 *label = nullptr;
+        if (next_label < labels.size() && labels[next_label].address == line.address)
+            label = &labels[next_label].id;
 
-    using std::left, std::endl, std::setw;
+        write_listing_line(out, line, label);
 
+        if(++written % PROGRESS_STEP == 0) progress.advance(PROGRESS_STEP);
+    }
+    progress.advance(written % PROGRESS_STEP);
+
+    write_listing_footer(out);
+
+    out.close();
+}
+
+void sic::dasm::write_symtab_to_file() {
+    file_writer out(symtabfile);
+    write_symtab(out);
+    out.close();
+}
+
+void sic::dasm::write_listing_header(file_writer &out) {
     // table header
-    out << left << setw(8)  << "LOC"      // location
-        << left << setw(10) << "LABEL"    // label (if any)
-        << left << setw(10) << "MNEMONIC" // instruction
-        << left << setw(18) << "OPERAND"  // operands
-        << "OBJ CODE"                     // hex at the end
-        << endl;
+    out.column("LOC", 8);       // location
+    out.column("LABEL", 10);    // label (if any)
+    out.column("MNEMONIC", 10); // instruction
+    out.column("OPERAND", 18);  // operands
+    out.line("OBJ CODE");       // hex at the end
 
-    out << "-------------------------------------------------------------" << endl;
+    out.line(LISTING_RULE);
 
-    out << left << setw(8)  << "" 
-        << left << setw(10) << "" 
-        << left << setw(10) << "START" 
-        << prog_name << endl;
+    out.column("", 18);
+    out.column("START", 10);
+    out.line(prog_name);
+}
 
-    for(const auto &line : assembly) {
-        // column 1 - loc
-        out << left << setw(8) << base::bintohex(line.address, 4);
+void sic::dasm::write_listing_line(file_writer &out, const asmline &line, const u32 *label) {
+    char text[48];
 
-        // column 2 - label 
-        if (symtab.count(line.address))
-            out << left << setw(10) << symtab[line.address];
-        else
-            out << left << setw(10) << ""; 
+    // both modes write every line through here, so this is what the listing has
+    counts.lines[(u8)line.kind]++;
+    counts.bytes[(u8)line.kind] += line.len;
+    if(line.flags & LINE_EXTENDED) counts.extended++;
 
-        // column 3 - mnemonic
-        out << left << setw(10) << line.inst.mnemonic;
+    // the bytes of the line (gaps have none)
+    u8 bytes[4];
+    bool is_gap = line.kind == operand_kind::resw || line.kind == operand_kind::resb;
+    usize nbytes = is_gap ? 0 : std::min<u32>(line.len, 4);
+    memory.read(line.address, bytes, nbytes);
 
-        // column 4 - operand
-        out << left << setw(18) << line.operand;
+    // column 1 - loc
+    char *end = base::format_hex(text, line.address, 4);
+    out.column(std::string_view(text, end - text), 8);
 
-        // column 5 - obj code
-        out << line.objcode;
+    // column 2 - label
+    if (label) {
+        end = format_label(text, *label);
+        out.column(std::string_view(text, end - text), 10);
+    }
+    else
+        out.column("", 10);
 
-        out << endl;
+    // column 3 - mnemonic (fmt 4 gets the '+' prefix)
+    if(line.flags & LINE_EXTENDED) {
+        out.put('+');
+        out.column(mnemonic_of(line), 9);
     }
+    else
+        out.column(mnemonic_of(line), 10);
 
-    // table footer
-    out << "-------------------------------------------------------------" << endl;
-    out << left << setw(8)  << ""
-        << left << setw(10) << ""
-        << left << setw(10) << "END"
-        << prog_name << endl;
+    // column 4 - operand
+    end = format_operand(text, line, bytes);
+    out.column(std::string_view(text, end - text), 18);
 
-    out.close();
+    // column 5 - obj code
+    end = base::format_hex_bytes(text, bytes, nbytes);
+    out.line(std::string_view(text, end - text));
 }
 
-void sic::dasm::write_symtab_to_file() {
-    ofstream out(symtabfile);
+void sic::dasm::write_listing_footer(file_writer &out) {
+    // table footer
+    out.line(LISTING_RULE);
 
-    using std::left, std::endl, std::setw;
+    out.column("", 18);
+    out.column("END", 10);
+    out.line(prog_name);
+}
 
+void sic::dasm::write_symtab(file_writer &out) {
     // table header
-    out << left << setw(10)  << "SYMBOL"      // label 
-        << left << setw(10) << "ADDRESS"      // location
-        << endl;
+    out.column("SYMBOL", 10);  // label
+    out.column("ADDRESS", 10); // location
+    out.put('\n');
 
-    out << "--------------------" << endl;
+    out.line("--------------------");
 
-    string refname = "REF";
+    char row[32];
 
-    for(const auto &[addr, name] : symtab) {
-        out << left << setw(10) << name
-            << base::bintohex(addr, 4)
-            << endl;
-    }
+    for(const auto &label : labels) {
+        // NAME      ADDR, padded like the header
+        char *end = format_label(row, label.id);
+        while (end < row + 10) *end++ = ' ';
+        end = base::format_hex(end, label.address, 4);
 
-    out << "--------------------" << endl;
+        out.line(std::string_view(row, end - row));
+    }
 
-    out.close();
+    out.line("--------------------");
 }
 
 // internal functions
-string sic::dasm::get_label(u32 addr) {
-    // 1. If we already visited this address, return existing label
-    if (symtab.find(addr) != symtab.end()) {
-        return symtab[addr];
+void sic::dasm::count_record(char rec_type) {
+    switch(rec_type) {
+        case 'H': counts.records[0]++; break;
+        case 'T': counts.records[1]++; break;
+        case 'M': counts.records[2]++; break;
+        case 'E': counts.records[3]++; break;
+        default:  counts.records[4]++; break;
     }
+}
 
-    // 2. Generate new label (REF + 4 digit counter)
-    stringstream ss;
-    ss << "REF" << std::setfill('0') << std::setw(4) << label_counter++;
-    string label = ss.str();
+void sic::dasm::finish_stats() {
+    stats.end();
+
+    auto lines = [this](operand_kind kind) { return counts.lines[(u8)kind]; };
+    auto bytes = [this](operand_kind kind) { return counts.bytes[(u8)kind]; };
+
+    stats.set("records_h", counts.records[0]);
+    stats.set("records_t", counts.records[1]);
+    stats.set("records_m", counts.records[2]);
+    stats.set("records_e", counts.records[3]);
+    stats.set("records_other", counts.records[4]);
+    stats.set("bytes_loaded", counts.bytes_loaded);
+
+    // fmt 3 and 4 both end up as immediate/memory lines, the '+' tells them apart
+    stats.set("instr_fmt1", lines(operand_kind::none));
+    stats.set("instr_fmt2", lines(operand_kind::registers));
+    stats.set("instr_fmt3", lines(operand_kind::immediate) + lines(operand_kind::memory) - counts.extended);
+    stats.set("instr_fmt4", counts.extended);
+    stats.set("data_lines", lines(operand_kind::data_byte));
+    stats.set("data_bytes", bytes(operand_kind::data_byte));
+    stats.set("reserved_lines", lines(operand_kind::resw) + lines(operand_kind::resb));
+    stats.set("reserved_bytes", bytes(operand_kind::resw) + bytes(operand_kind::resb));
+    stats.set("labels", label_counter);
+}
+
+u32 sic::dasm::get_label(u32 addr) {
+    // one probe: returns the existing id if we already visited this address,
+    // otherwise stores the next REF number
+    auto [id, inserted] = label_ids.insert(addr, label_counter);
+    if (inserted) label_counter++;
 
-    // 3. Store in map and return
-    symtab[addr] = label;
-    return label;
+    return *id;
 }
 
 void sic::dasm::process_obj_file() {
-    ifstream file(objfile);
-    
-    LDEBUG(true, "\nopenning obj file for parsing...\n")
-    if(!file.is_open()) {
-        string msg = "couldn't open .obj file at " + objfile;
-        throw ylib::Error(msg.c_str());
-    }
+    LDEBUG(true, "\nmapping obj file for parsing...\n")
 
-    LDEBUG(true, GREEN_TEXT("\nopenned obj file sucessfuly...\n"))
+    // throws if the file can't be opened/mapped
+    mapped_file file(objfile);
 
-    string line;
-    while(getline(file, line)) {
-        if(line.empty()) continue; // ignore empty lines
+    LDEBUG(true, GREEN_TEXT("\nmapped obj file sucessfuly...\n"))
 
-        string clean_line = "";
-        for (char c : line) {
-            if (c != '^' && c != '\r') {
-                clean_line += c;
-            }
-        }
+    record_reader reader(file.view());
+    record rec;
 
-        if(clean_line.empty()) continue;
+    progress.phase("loading obj file...", file.view().size());
 
-        LDEBUG(true, "\noutputting HTE line:\t", clean_line, "\n")
+    while(reader.next(rec)) {
+        LDEBUG(true, "\noutputting HTE line:\t", rec.raw, "\n")
 
-        char rec_type = clean_line[0];
+        progress.advance(rec.raw.size() + 1); // + the newline
+
+        char rec_type = rec.type();
+        count_record(rec_type);
 
         switch (rec_type)
         {
         case 'H':
-            process_header(clean_line);
+            process_header(rec);
             break;
         case 'T':
-            process_text(clean_line);
+            process_text(rec);
             break;
         case 'M':
             // TODO: process modifications for linker/loader
             break;
         case 'E':
-            process_end(clean_line);
+            process_end(rec);
             break;
         
         default:
@@ -248,159 +763,156 @@ void sic::dasm::process_obj_file() {
         // just stop if you read E
         if(rec_type == 'E') break;
     }
-
-    file.close();
 }
 
-void sic::dasm::process_header(string record) {
+void sic::dasm::process_header(const record &rec) {
     // H^PROGNAME^STARTADDR^LENGTH
     // 0 1        7         13
 
-    LDEBUG(true, "processing header\t", record, "\n\tlength: ", record.length(), "\n");
+    LDEBUG(true, "processing header\t", rec.raw, "\n\tlength: ", rec.length(), "\n");
     
     // prog name: 6 characters
-    string prog_name = record.substr(1, 6);
-    this->prog_name = prog_name;
+    this->prog_name = string(rec.field(1, 6));
 
     // start: 6 characters
-    string start_addr_str = record.substr(7, 6);
-    u32 start_addr = base::hextobin<u32>(start_addr_str);
+    u32 start_addr = base::hextobin<u32>(rec.field(7, 6));
 
-    string prog_len_str = record.substr(13, 6);
-    u32 prog_len = base::hextobin<u32>(prog_len_str);
+    u32 prog_len = base::hextobin<u32>(rec.field(13, 6));
     this->prog_len = prog_len;
 
     // len = end - start => end = len + start
     u32 end_addr = prog_len + start_addr;
 
-    // initialize memory map with the proper size (with extra padding)
-    memory = vector<u8>(end_addr + 10, 0);
-    is_initialized = vector<bool>(end_addr + 10, false);
+    // reset the memory map, pages get allocated as T records fill them
+    // (the limit keeps the extra padding the decoder relies on)
+    memory.clear();
+    coverage.clear();
+    mem_limit = end_addr + 10;
 
     // init class variables
     this->start_addr = start_addr;
     this->locctr = start_addr;
 }
 
-void sic::dasm::process_text(string record) {
+void sic::dasm::process_text(const record &rec) {
     // ex: T^000000^00^..............
     //       ^----- 6 characters
 
-    LDEBUG(true, "processing text\t", record, "\n\tlength: ", record.length(), "\n");
+    LDEBUG(true, "processing text\t", rec.raw, "\n\tlength: ", rec.length(), "\n");
     
-    string start_addr_str = record.substr(1, 6);
-    u32 curr_addr = base::hextobin<u32>(start_addr_str);
+    u32 curr_addr = base::hextobin<u32>(rec.field(1, 6));
 
     // length
-    string record_len_str = record.substr(7, 2);
-    u32 record_len = base::hextobin<u32>(record_len_str);
-
-    string object_code = record.substr(9);
-    for(i32 i = 0; i < record_len; i++) {
-        if (2 * i + 1 >= object_code.length())
-            break;
-
-        string byte_str = object_code.substr(2 * i, 2);
+    u32 record_len = base::hextobin<u32>(rec.field(7, 2));
+
+    // clip the record to the memory map
+    if(curr_addr >= mem_limit) return;
+    usize max_len = std::min((usize)record_len, (usize)(mem_limit - curr_addr));
+
+    // object code starts at 9, decoded straight into the memory page when the
+    // record fits in it and lands on bytes no earlier record set (almost always),
+    // through a small buffer otherwise. invalid digit pairs are skipped (left as
+    // they were) instead of throwing: the decoder writes them as 0, so only the
+    // buffer path can keep an older record's bytes under them
+    u64 valid[4];
+    usize avail = 0;
+    u8 *page_ptr = memory.span(curr_addr, avail);
+
+    usize run = coverage.find(curr_addr);
+    bool overlaps = run < coverage.size() && coverage[run].start < curr_addr + max_len;
+
+    usize len = 0;
+    usize clean = 0;
+
+    if(max_len <= avail && !overlaps) {
+        len = rec.decode_hex(9, max_len, page_ptr, valid, &clean);
+        memory.mark(curr_addr, len, valid);
+    }
+    else {
+        u8 bytes[0xFF];
+        len = rec.decode_hex(9, max_len, bytes, valid, &clean);
 
-        if (!isxdigit(byte_str[0]) || !isxdigit(byte_str[1]))
-            continue; // skip invalid garbage
+        if(clean == len) memory.write(curr_addr, bytes, len);
+        else memory.write(curr_addr, bytes, len, valid);
+    }
 
-        u8 val = base::hextobin<u8>(byte_str);
+    counts.bytes_loaded += len;
 
-        // write this byte to the memory map
-        if(curr_addr + i < memory.size()) {
-            memory[curr_addr + i] = val;
-            is_initialized[curr_addr + i] = true;
-        }
-    }
+    // record what this T record covered (one run unless it had garbage in it)
+    if(clean == len) coverage.add(curr_addr, curr_addr + len);
+    else coverage.add(curr_addr, len, valid);
 }
 
-void sic::dasm::process_end(string record) {
+void sic::dasm::process_end(const record &rec) {
     // E^000000
-    if (record.length() >= 7) {
-        string start_exec_str = record.substr(1, 6);
-        this->locctr = base::hextobin<u32>(start_exec_str);
+    if (rec.length() >= 7) {
+        this->locctr = base::hextobin<u32>(rec.field(1, 6));
     }
 }
 
-sic::asmline sic::dasm::decode_instruction(const u32 &addr)
+sic::asmline sic::dasm::decode_instruction(const u32 &addr) const
 {
-    asmline line;
-    line.address = addr;
-
     // check mem bounds
-    if(addr >= memory.size()) {
+    if(addr >= mem_limit) {
+        asmline line{};
+        line.address = addr;
         line.len = 0; // end of program
         return line;
     }
 
-    // get byte from memory map
-    u8 byte1 = memory[addr];
+    // get the (up to 4) bytes of the instruction from the memory map
+    u8 bytes[4];
+    memory.read(addr, bytes, 4);
+
+    return decode_bytes(bytes, addr, mem_limit);
+}
+
+sic::asmline sic::dasm::decode_bytes(const u8 *bytes, u32 addr, u32 mem_limit)
+{
+    asmline line{};
+    line.address = addr;
+
+    // anything that doesn't decode is a single data byte
+    auto data_byte = [&line]() {
+        line.kind = operand_kind::data_byte;
+        line.len = 1;
+        return line;
+    };
+
+    u8 byte1 = bytes[0];
     u8 opcode = byte1 & 0xFC; // mask off the least 2 bits (n i flags)
     
     // unknown opcode -> handle as data
-    if(op::instr_table.find(opcode) == op::instr_table.end()) {
-        line.inst.mnemonic = "BYTE";
-        line.len = 1;
-        line.objcode = base::bintohex(byte1, 2);
-        line.operand = "X'" + line.objcode + "'";
-        return line;
-    }
+    const op::instruction &inst = op::instr_table[opcode];
+    if(inst.format == 0) return data_byte();
 
-    op::instruction inst = op::instr_table[opcode];
-    line.inst = inst;
+    line.opcode = opcode;
 
     // --- fmt 1 ---
     if(inst.format == 1) {
         line.len = 1;
-        line.objcode = base::bintohex(byte1, 2);
+        line.kind = operand_kind::none;
         return line;
     }
 
     // --- fmt 2 ---
     if(inst.format == 2) {
         // not enough mem for fmt 2 -> handle as data
-        if (addr + 1 >= memory.size()) { 
-            line.len = 1;
-            line.inst.mnemonic = "BYTE";
-            line.objcode = base::bintohex(byte1, 2);
-            line.operand = "X'" + line.objcode + "'";
-            return line; 
-        }
-
-        line.len = 2;
-        u8 byte2 = memory[addr + 1];
-        line.objcode = base::bintohex(byte1, 2) + base::bintohex(byte2, 2);
+        if (addr + 1 >= mem_limit) return data_byte();
 
         // [opcode][r1][r2]
         //    8     4   4
-        u8 r1 = (byte2 >> 4) & 0xF; 
-        u8 r2 = byte2 & 0xF;
-
-        // unkown registers -> just put as 'U'
-        string reg1 = op::reg_table.count(r1) ? op::reg_table.at(r1) : "U";
-        string reg2 = op::reg_table.count(r2) ? op::reg_table.at(r2) : "U";
-
-        if(inst.mnemonic == "CLEAR" || inst.mnemonic == "TIXR" || inst.mnemonic == "SVC") {
-            // the only fmt 2 instructions that have 1 operand
-            line.operand = reg1;
-        } else {
-            line.operand = reg1 + ", " + reg2;
-        }
+        line.len = 2;
+        line.kind = operand_kind::registers;
+        line.value = bytes[1];
         return line;
     }
 
     // --- fmt 3/4 check ---
-    if (addr + 2 >= memory.size()) {
-        line.len = 1;
-        line.inst.mnemonic = "BYTE";
-        line.objcode = base::bintohex(byte1, 2);
-        line.operand = "X'" + line.objcode + "'";
-        return line;
-    }
+    if (addr + 2 >= mem_limit) return data_byte();
     
-    u8 byte2 = memory[addr + 1];
-    u8 byte3 = memory[addr + 2];
+    u8 byte2 = bytes[1];
+    u8 byte3 = bytes[2];
 
     // [opcode][nixbpe][disp]
     //               ^----- in byte 2 000e0000
@@ -418,21 +930,12 @@ sic::asmline sic::dasm::decode_instruction(const u32 &addr)
 
     if(ext) {
         // --- fmt 4: [opcode][nixbpe][addr] ---
+        if (addr + 3 >= mem_limit) return data_byte();
+
         line.len = 4;
-        line.inst.mnemonic = "+" + inst.mnemonic;
-        line.inst.format = 4;
-
-        if (addr + 3 >= memory.size()) {
-            line.len = 1;
-            line.inst.mnemonic = "BYTE";
-            line.objcode = base::bintohex(byte1, 2);
-            line.operand = "X'" + line.objcode + "'";
-            return line;
-        }
+        line.flags |= LINE_EXTENDED; // written as +MNEMONIC
 
-        u8 byte4 = memory[addr + 3];
-        line.objcode = base::bintohex(byte1, 2) + base::bintohex(byte2, 2) + 
-                       base::bintohex(byte3, 2) + base::bintohex(byte4, 2);
+        u8 byte4 = bytes[3];
 
         // dddress Calculation (full 20 bits)
         // [opcode][nixbpe][addr]
@@ -447,8 +950,6 @@ sic::asmline sic::dasm::decode_instruction(const u32 &addr)
     else {
         // --- fmt 3: [opcode][nixbpe][disp] ---
         line.len = 3;
-        line.objcode = base::bintohex(byte1, 2) + 
-                       base::bintohex(byte2, 2) + base::bintohex(byte3, 2);
 
         // disp = 12 bits = 4 bits from byte2 | byte3
         i32 disp = ((byte2 & 0xF) << 8) | byte3;
@@ -461,6 +962,9 @@ sic::asmline sic::dasm::decode_instruction(const u32 &addr)
         // 0 b p 0 0 0 0 0
         bool pc_rel = (byte2 >> 5) & 1;
         // base relative would be handled in symbol logic (i think)
+        bool base_rel = (byte2 >> 6) & 1;
+        if (base_rel && !pc_rel) line.flags |= LINE_BASE_REL;
+        if (pc_rel) line.flags |= LINE_PC_REL;
 
         if (pc_rel)
             final_target_address = (addr + 3) + disp;
@@ -468,27 +972,79 @@ sic::asmline sic::dasm::decode_instruction(const u32 &addr)
             final_target_address = disp; 
     }
 
-    // --- operand formatting ---
+    // --- operand ---
+    line.value = final_target_address;
 
     // n i flags -> n = 0, i = 1 (immediate)
     if (!n && i) {
-        line.is_mem_ref = false; 
-        line.operand = "#" + std::to_string(final_target_address);
+        line.kind = operand_kind::immediate;
     }
     // mem ref (simple or indirect)
     else {
-        line.is_mem_ref = true;
-        line.target_address = final_target_address;
+        line.kind = operand_kind::memory;
 
         // n i flags -> n = 1, i = 0 (indirect)
-        if (n && !i) line.operand = "@"; 
-        else line.operand = ""; // simple
+        if (n && !i) line.flags |= LINE_INDIRECT;
 
-        // NOTE: adding the symbol name (REFxxx) later in disassemble
+        // NOTE: the symbol name (REFxxx) is picked later, in assign_labels
     }
 
     // indexed addressing
-    line.indexed = x;
+    if (x) line.flags |= LINE_INDEXED;
 
     return line;
 }
+
+char *sic::dasm::format_operand(char *out, const asmline &line, const u8 *bytes) const {
+    switch(line.kind) {
+        case operand_kind::none:
+            return out;
+
+        case operand_kind::data_byte:
+            *out++ = 'X';
+            *out++ = '\'';
+            out = base::format_hex_bytes(out, bytes, std::min<u32>(line.len, 4));
+            *out++ = '\'';
+            return out;
+
+        case operand_kind::resw:
+        case operand_kind::resb:
+            return format_dec(out, line.value);
+
+        case operand_kind::registers: {
+            // unkown registers -> just put as 'U'
+            std::string_view reg1 = op::reg_names[(line.value >> 4) & 0xF];
+            std::string_view reg2 = op::reg_names[line.value & 0xF];
+
+            memcpy(out, reg1.data(), reg1.size());
+            out += reg1.size();
+
+            // the only fmt 2 instructions that have 1 operand
+            std::string_view mnemonic = op::instr_table[line.opcode].mnemonic;
+            if(mnemonic == "CLEAR" || mnemonic == "TIXR" || mnemonic == "SVC") return out;
+
+            *out++ = ',';
+            *out++ = ' ';
+            memcpy(out, reg2.data(), reg2.size());
+            return out + reg2.size();
+        }
+
+        case operand_kind::immediate:
+            *out++ = '#';
+            out = format_dec(out, line.value);
+            break;
+
+        case operand_kind::memory:
+            if(line.flags & LINE_INDIRECT) *out++ = '@';
+            out = format_label(out, line.value);
+            break;
+    }
+
+    // handle indexed
+    if(line.flags & LINE_INDEXED) {
+        memcpy(out, ", X", 3);
+        out += 3;
+    }
+
+    return out;
+}
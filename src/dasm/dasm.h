@@ -1,21 +1,70 @@
 #pragma once
 #include  "opcode_parser.h"
 #include "../util/cli.h"
+#include "../util/file_writer.h"
+#include "../util/flat_map.h"
+#include "../util/hex.h"
+#include "../util/interval_set.h"
+#include "../util/memory_image.h"
+#include "../util/record_reader.h"
+#include "../util/stats.h"
+#include "../util/thread_pool.h"
 
 namespace sic {
 
+// what the operand column of a line holds (the text is only rendered when written out)
+enum class operand_kind : u8 {
+    none,      // fmt 1
+    data_byte, // BYTE X'..' (unknown opcode, an instruction cut off by the end, or bytes
+               // the recursive traversal never reached: up to 3 of them)
+    registers, // fmt 2, r1 (CLEAR, TIXR, SVC) or r1, r2
+    immediate, // #value
+    memory,    // [@]REFxxxx
+    resw,      // RESW value
+    resb,      // RESB value
+};
+
+// asmline flags
+#define LINE_EXTENDED BIT(0) // fmt 4, written as +MNEMONIC
+#define LINE_INDIRECT BIT(1) // @operand
+#define LINE_INDEXED  BIT(2) // operand, X
+#define LINE_BASE_REL BIT(3) // fmt 3 base relative: value is only the displacement
+#define LINE_PC_REL   BIT(4) // fmt 3 pc relative: value is already the target
+
+// one line of the listing: a plain 16 byte record, no strings.
+// mnemonic, operand and object code are rebuilt from it (and the memory map) by the writer
 struct asmline {
-    i32 address;
-    op::instruction inst;
-    string operand;
-    string objcode;
+    u32 address;
+    u32 len; // length in bytes
+
+    // depends on kind: the immediate, the resw/resb count, the fmt 2 register byte,
+    // or for memory the target address (replaced by its label id in assign_labels)
+    u32 value;
+
+    u8 opcode; // index into op::instr_table
+    operand_kind kind;
+    u8 flags;
+    u8 reserved;
+};
 
-    i32 len; // length in bytes
+static_assert(sizeof(asmline) == 16, "asmline should stay a 16 byte record");
 
-    // symtab specific
-    bool is_mem_ref = false;
-    bool indexed = false;
-    u32 target_address = 0;
+// what a run went through (--stats), bumped where records are read and lines written
+struct dasm_counts {
+    u64 records[5] = {};  // H, T, M, E, anything else
+    u64 bytes_loaded = 0; // T record payload that made it into the memory map
+    u64 lines[7] = {};    // written lines per operand_kind
+    u64 bytes[7] = {};    // and the bytes they cover
+    u64 extended = 0;     // fmt 4 lines
+};
+
+// listing separator line
+#define LISTING_RULE "-------------------------------------------------------------"
+
+// a named address, REF + id (the name is only rendered when written out)
+struct label_entry {
+    u32 address;
+    u32 id;
 };
 
 class dasm {
@@ -30,34 +79,109 @@ private:
     string symtabfile;
 
     u32 locctr; // location counter
-    vector<u8> memory; // memory map to split the object code to bytes
-    vector<bool> is_initialized; // true = code/data exist here. false = RESW/RESB
+    memory_image memory; // memory map to split the object code to bytes (initialized = code/data, else RESW/RESB)
+    u32 mem_limit = 0;   // end of the program + padding, nothing is loaded or decoded past it
+    interval_set coverage; // address runs written by T records, the holes are RESW/RESB
 
     // symtab
-    map<u32, string> symtab;
+    flat_map<u32, u32> label_ids; // address -> label id, filled while labelling
+    vector<label_entry> labels;   // the same, sorted by address once labelling is done
     u32 label_counter = 0;
 
     // dissambly output (vector of asmlines to store the program)
     vector<asmline> assembly;
 
+    // a piece of a covered run, decoded on its own (possibly on another thread)
+    struct decode_chunk {
+        u32 start;
+        u32 end;
+        vector<asmline> lines;
+    };
+
+    // streaming (run_streaming): how far the listing got
+    struct stream_state {
+        u32 curr = 0;     // next address to write
+        u32 settled = 0;  // bytes below this were read by written lines
+        u32 frontier = 0; // start of the latest T record, everything below is final
+        bool header_written = false;
+    };
+
+    // recursive traversal: a straight piece of code, decoded once
+    struct code_block {
+        u32 start;
+        u32 end;
+        usize first; // its lines are traced_lines[first, first + count)
+        usize count;
+    };
+
+    u32 threads = 1; // decoder threads (1 = sequential)
+    bool recursive = false; // follow the control flow from the entry point instead of a linear sweep
+    bool quiet = false; // no progress bar / success message (batch mode, --quiet)
+
+    // loaded record bytes / decoded bytes / written lines (only counters, so decoding stays const)
+    mutable ::cli::progress progress;
+
+    // phase timings + tallies for --stats
+    run_stats stats;
+    dasm_counts counts;
+
+    void count_record(char rec_type);
+    void finish_stats();
+
     // helpers
-    string get_label(u32 addr);
+    u32 get_label(u32 addr);
+    void push_gap(u32 gap_start, u32 gap_end);
+    static asmline gap_line(u32 gap_start, u32 gap_end);
+
+    // disassemble() phases
+    vector<decode_chunk> split_chunks(u32 start, u32 end) const;
+    void decode_chunk_lines(decode_chunk &chunk) const;
+    void merge_chunks(vector<decode_chunk> &chunks, u32 start, u32 end);
+    void assign_labels();
+    void sort_labels();
+
+    // recursive traversal (disassemble() with recursive set)
+    void trace_code(u32 start, u32 end);
+    void emit_data(u32 data_start, u32 data_end);
+
+    // streaming mode ('-' as input or output)
+    void run_streaming();
+    template<typename reader_t>
+    void stream_records(reader_t &reader, file_writer &out, stream_state &state);
+    void emit_stream_lines(file_writer &out, stream_state &state, bool final);
+
+    // writers
+    void write_listing_header(file_writer &out);
+    void write_listing_line(file_writer &out, const asmline &line, const u32 *label);
+    void write_listing_footer(file_writer &out);
+    void write_symtab(file_writer &out);
     
     // main methods
     void process_obj_file();
-    void process_header(string record);
-    void process_text(string record);
-    void process_end(string record);
+    void process_header(const record &rec);
+    void process_text(const record &rec);
+    void process_end(const record &rec);
     
-    asmline decode_instruction(const u32 &address);
+    asmline decode_instruction(const u32 &address) const;
+    char *format_operand(char *out, const asmline &line, const u8 *bytes) const;
 
 public:
 
     dasm(string objfile, string asmfile, string symtabfile);
+    void set_threads(u32 count) { threads = count ? count : (u32)thread_pool::default_threads(); }
+    void set_quiet(bool q) { quiet = q; }
+    void set_recursive(bool r) { recursive = r; }
     void run();
     void disassemble();
     void write_asm_to_file();
     void write_symtab_to_file();
+
+    // timings and counters of the last run (phases: load, decode, write or stream)
+    const run_stats &get_stats() const { return stats; }
+
+    // decodes the instruction in bytes (the 4 bytes at addr), nothing at or past mem_limit
+    // is part of it. shared with the vm's predecoder
+    static asmline decode_bytes(const u8 *bytes, u32 addr, u32 mem_limit);
 };
 
 } // namespace sic
\ No newline at end of file
@@ -6,63 +6,105 @@
 
 #include "../util/base.h"
 
+#include <array>
+#include <string_view>
+
 namespace op {
 
 struct instruction {
-    string mnemonic;
+    std::string_view mnemonic;
     u8 opcode; // opcode is 8-bits
-    u8 format; // only 2 bits needed
+    u8 format; // 1-4, 0 = no instruction has this opcode
 
-    instruction() {}
-    instruction(string n, u8 opc, u8 fmt)
+    constexpr instruction()
+        :mnemonic(), opcode(0), format(0)
+    {}
+    constexpr instruction(std::string_view n, u8 opc, u8 fmt)
         :mnemonic(n), opcode(opc), format(fmt)
     {}
 };
 
-// global map to store the instructions
-// maps opcode -> instruction (since we are disassembling)
-inline map<u8, instruction> instr_table;
-
-const map<u8, string> reg_table = {
-    {0, "A"},
-    {1, "X"},
-    {2, "L"},
-    {3, "B"},
-    {4, "S"},
-    {5, "T"},
-    {6, "F"},
-    {8, "PC"},
-    {9, "SW"}
+// maps opcode -> instruction (since we are disassembling).
+// indexed by the full opcode byte, so a lookup is a single load
+typedef std::array<instruction, 256> opcode_table;
+
+constexpr opcode_table make_builtin_table() {
+    opcode_table table{};
+
+    #define SIC_OPCODE(name, opc, fmt) table[opc] = instruction(#name, opc, fmt);
+    #include "opcodes.def"
+    #undef SIC_OPCODE
+
+    return table;
+}
+
+// built at compile time from opcodes.def, no startup i/o
+inline constexpr opcode_table builtin_table = make_builtin_table();
+
+// global table used by the tools (constant initialized from builtin_table)
+inline opcode_table instr_table = builtin_table;
+
+// register number -> name, 'U' for the numbers no register uses
+inline constexpr std::array<std::string_view, 16> reg_names = {
+    "A", "X", "L", "B", "S", "T", "F", "U",
+    "PC", "SW", "U", "U", "U", "U", "U", "U"
 };
 
+// backing storage for the mnemonics of a custom table (instr_table views into it)
+inline string custom_source;
+
+// replaces instr_table with a custom ISA description.
+// file format is the one of res/opcodes.txt: <MNEMONIC> <OPCODE (hex)> <FORMAT> per line
 inline void load_instructions(string filepath) {
-    ifstream file(filepath);
-    
+    ifstream file(filepath, std::ios::binary);
+
     if(!file.is_open()) {
-        string msg = "couldn't open file at " + filepath;
-        throw ylib::Error(msg.c_str());
+        throw ylib::Error("couldn't open file at " + filepath);
     }
 
-    string line;
-    while(getline(file, line)) {
-        stringstream ss(line);
+    stringstream contents;
+    contents << file.rdbuf();
+    custom_source = contents.str();
 
-        string mnemonic;
-        string opcode;
-        u8 format;
+    opcode_table table{};
+    std::string_view src = custom_source;
 
-        ss >> mnemonic >> opcode >> format;
+    // splits off the next whitespace separated token of a line
+    auto next_token = [](std::string_view &line) {
+        usize start = line.find_first_not_of(" \t\r");
+        if(start == std::string_view::npos) {
+            line = std::string_view();
+            return std::string_view();
+        }
 
-        u8 opc = base::hextobin<u8>(opcode);
+        usize end = line.find_first_of(" \t\r", start);
+        if(end == std::string_view::npos) end = line.size();
+
+        std::string_view token = line.substr(start, end - start);
+        line.remove_prefix(end);
+        return token;
+    };
+
+    while(!src.empty()) {
+        usize nl = src.find('\n');
+        std::string_view line = src.substr(0, nl);
+        src.remove_prefix(nl == std::string_view::npos ? src.size() : nl + 1);
+
+        std::string_view mnemonic = next_token(line);
+        std::string_view opcode = next_token(line);
+        std::string_view format = next_token(line);
 
-        instruction inst(
-            mnemonic,
-            opc,
-            format
-        );
+        if(mnemonic.empty()) continue; // blank line
 
-        instr_table[opc] = inst;
+        if(opcode.empty() || format.size() != 1 || format[0] < '1' || format[0] > '4') {
+            throw ylib::Error("malformed opcode entry in " + filepath + ": " + string(mnemonic));
+        }
+
+        u8 opc = base::hextobin<u8>(opcode);
+        table[opc] = instruction(mnemonic, opc, format[0] - '0');
     }
+
+    instr_table = table;
 }
 
-};
\ No newline at end of file
+};
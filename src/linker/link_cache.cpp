@@ -0,0 +1,336 @@
+#include "link_cache.h"
+#include "linker.h"
+
+#include <filesystem>
+#include <stdio.h>
+
+namespace fs = std::filesystem;
+
+// helpers
+namespace {
+
+// bump OBJECT_VERSION/STATE_VERSION whenever a layout below changes
+constexpr u32 OBJECT_MAGIC = 0x434C5853; // "SXLC"
+constexpr u32 STATE_MAGIC  = 0x534C5853; // "SXLS"
+constexpr u32 OBJECT_VERSION = 2;
+constexpr u32 STATE_VERSION  = 1;
+
+// appends plain values to a byte buffer (native byte order, the cache never leaves the machine)
+struct byte_writer {
+    vector<u8> bytes;
+
+    template<typename T>
+    void put(T val) {
+        const u8 *src = reinterpret_cast<const u8 *>(&val);
+        bytes.insert(bytes.end(), src, src + sizeof(T));
+    }
+
+    void put(std::string_view str) {
+        put<u32>(str.size());
+        bytes.insert(bytes.end(), str.begin(), str.end());
+    }
+
+    void put(const u8 *src, usize n) { bytes.insert(bytes.end(), src, src + n); }
+};
+
+// reads them back, every get fails (returns false) once the data runs out
+struct byte_reader {
+    const u8 *pos;
+    const u8 *end;
+
+    template<typename T>
+    bool get(T &val) {
+        if((usize)(end - pos) < sizeof(T)) return false;
+        memcpy(&val, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool get(std::string_view &str) {
+        u32 len;
+        if(!get(len) || (usize)(end - pos) < len) return false;
+        str = std::string_view(reinterpret_cast<const char *>(pos), len);
+        pos += len;
+        return true;
+    }
+
+    // n bytes in place
+    const u8 *take(usize n) {
+        if((usize)(end - pos) < n) return nullptr;
+        const u8 *at = pos;
+        pos += n;
+        return at;
+    }
+};
+
+// the file appears whole or not at all (a crash mid-write leaves the old one)
+void write_file(const string &path, const vector<u8> &bytes) {
+    string tmp = path + ".tmp";
+
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if(!file) {
+        throw ylib::Error("couldn't write link cache file " + path);
+    }
+
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok &= fclose(file) == 0;
+
+    std::error_code err;
+    if(ok) fs::rename(tmp, path, err);
+
+    if(!ok || err) {
+        fs::remove(tmp, err);
+        throw ylib::Error("couldn't write link cache file " + path);
+    }
+}
+
+} // namespace
+
+sic::link_cache::link_cache(const string &dir) : dir{dir} {
+    std::error_code err;
+    fs::create_directories(dir, err);
+
+    if(!fs::is_directory(dir)) {
+        throw ylib::Error("couldn't create link cache directory " + dir);
+    }
+}
+
+string sic::link_cache::object_path(const string &path) const {
+    // one file per input path (the path itself is stored inside to catch collisions)
+    std::error_code err;
+    fs::path full = fs::absolute(path, err);
+
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.lko", base::fnv1a(err ? path : full.string()));
+
+    return (fs::path(dir) / name).string();
+}
+
+sic::file_stamp sic::link_cache::stat(const string &path) {
+    file_stamp stamp;
+    std::error_code err;
+
+    stamp.size = fs::file_size(path, err);
+    if(err) return file_stamp{};
+
+    stamp.mtime = (u64)fs::last_write_time(path, err).time_since_epoch().count();
+    return stamp;
+}
+
+// --- objects ---
+bool sic::link_cache::read_object(const string &path, object_file &obj, file_stamp &stamp) const {
+    string cache_path = object_path(path);
+    if(!fs::exists(cache_path)) return false;
+
+    // the records point into the file, so the whole file moves into the arena
+    object_file cached;
+    {
+        mapped_file file(cache_path);
+        std::string_view view = file.view();
+
+        u8 *data = cached.storage.alloc_array<u8>(std::max<usize>(view.size(), 1));
+        memcpy(data, view.data(), view.size());
+
+        byte_reader in{data, data + view.size()};
+
+        u32 magic, version;
+        std::string_view stored_path;
+        if(!in.get(magic) || !in.get(version) || magic != OBJECT_MAGIC || version != OBJECT_VERSION) return false;
+        if(!in.get(stamp.mtime) || !in.get(stamp.size) || !in.get(stamp.hash)) return false;
+        if(!in.get(stored_path) || stored_path != path) return false;
+
+        u32 n_sections, n_defines, n_texts, n_mods;
+        if(!in.get(n_sections) || !in.get(n_defines) || !in.get(n_texts) || !in.get(n_mods)) return false;
+
+        cached.sections.resize(n_sections);
+        for(control_section &cs : cached.sections) {
+            bool ok = in.get(cs.name) && in.get(cs.length) &&
+                      in.get(cs.defines.first) && in.get(cs.defines.count) &&
+                      in.get(cs.texts.first) && in.get(cs.texts.count) &&
+                      in.get(cs.modifies.first) && in.get(cs.modifies.count) &&
+                      in.get(cs.has_entry) && in.get(cs.entry);
+            if(!ok) return false;
+
+            bool in_range = (u64)cs.defines.first + cs.defines.count <= n_defines &&
+                            (u64)cs.texts.first + cs.texts.count <= n_texts &&
+                            (u64)cs.modifies.first + cs.modifies.count <= n_mods;
+            if(!in_range) return false;
+        }
+
+        cached.defines.resize(n_defines);
+        for(define_entry &def : cached.defines) {
+            if(!in.get(def.symbol) || !in.get(def.rel_addr)) return false;
+        }
+
+        cached.texts.resize(n_texts);
+        for(text_chunk &text : cached.texts) {
+            if(!in.get(text.rel_addr) || !in.get(text.len)) return false;
+            if(!(text.bytes = in.take(text.len))) return false;
+        }
+
+        cached.modifies.resize(n_mods);
+        for(modify_entry &mod : cached.modifies) {
+            bool ok = in.get(mod.rel_addr) && in.get(mod.len_nibbles) && in.get(mod.sign) &&
+                      in.get(mod.symbol) && in.get(mod.symbol_text);
+            if(!ok) return false;
+        }
+
+        if(in.pos != in.end) return false;
+    }
+
+    cached.path = path;
+    cached.hash = stamp.hash;
+    obj = std::move(cached);
+
+    return true;
+}
+
+void sic::link_cache::write_object(const object_file &obj, const file_stamp &stamp) const {
+    byte_writer out;
+
+    out.put(OBJECT_MAGIC);
+    out.put(OBJECT_VERSION);
+    out.put(stamp.mtime);
+    out.put(stamp.size);
+    out.put(stamp.hash);
+    out.put(std::string_view(obj.path));
+
+    out.put<u32>(obj.sections.size());
+    out.put<u32>(obj.defines.size());
+    out.put<u32>(obj.texts.size());
+    out.put<u32>(obj.modifies.size());
+
+    for(const control_section &cs : obj.sections) {
+        out.put(cs.name);
+        out.put(cs.length);
+        out.put(cs.defines.first);
+        out.put(cs.defines.count);
+        out.put(cs.texts.first);
+        out.put(cs.texts.count);
+        out.put(cs.modifies.first);
+        out.put(cs.modifies.count);
+        out.put(cs.has_entry);
+        out.put(cs.entry);
+    }
+
+    for(const define_entry &def : obj.defines) {
+        out.put(def.symbol);
+        out.put(def.rel_addr);
+    }
+
+    for(const text_chunk &text : obj.texts) {
+        out.put(text.rel_addr);
+        out.put(text.len);
+        out.put(text.bytes, text.len);
+    }
+
+    for(const modify_entry &mod : obj.modifies) {
+        out.put(mod.rel_addr);
+        out.put(mod.len_nibbles);
+        out.put(mod.sign);
+        out.put(mod.symbol);
+        out.put(mod.symbol_text);
+    }
+
+    write_file(object_path(obj.path), out.bytes);
+}
+
+// --- link state ---
+bool sic::link_cache::read_state(link_state &state) const {
+    string state_path = (fs::path(dir) / "link.state").string();
+    if(!fs::exists(state_path)) return false;
+
+    mapped_file file(state_path);
+    std::string_view view = file.view();
+    byte_reader in{reinterpret_cast<const u8 *>(view.data()), reinterpret_cast<const u8 *>(view.data()) + view.size()};
+
+    link_state loaded;
+
+    u32 magic, version;
+    if(!in.get(magic) || !in.get(version) || magic != STATE_MAGIC || version != STATE_VERSION) return false;
+    if(!in.get(loaded.prog_addr) || !in.get(loaded.total_len)) return false;
+
+    u32 n_inputs;
+    if(!in.get(n_inputs)) return false;
+
+    for(u32 i = 0; i < n_inputs; i++) {
+        link_input input;
+        std::string_view path;
+        u32 n_lengths;
+
+        if(!in.get(path) || !in.get(input.hash) || !in.get(n_lengths)) return false;
+        input.path = string(path);
+
+        const u8 *lengths = in.take((usize)n_lengths * sizeof(u32));
+        if(!lengths) return false;
+
+        input.lengths.resize(n_lengths);
+        memcpy(input.lengths.data(), lengths, (usize)n_lengths * sizeof(u32));
+
+        loaded.inputs.push_back(std::move(input));
+    }
+
+    u32 n_symbols;
+    if(!in.get(n_symbols)) return false;
+
+    loaded.estab.resize(n_symbols);
+    for(auto &[sym, addr] : loaded.estab) {
+        if(!in.get(sym) || !in.get(addr)) return false;
+    }
+
+    u32 n_runs;
+    if(!in.get(n_runs)) return false;
+
+    for(u32 i = 0; i < n_runs; i++) {
+        u32 start, end;
+        if(!in.get(start) || !in.get(end)) return false;
+        loaded.written.add(start, end);
+    }
+
+    usize image_len = loaded.written.covered();
+    const u8 *image = in.take(image_len);
+    if(!image || in.pos != in.end) return false;
+
+    loaded.image.assign(image, image + image_len);
+
+    state = std::move(loaded);
+    return true;
+}
+
+void sic::link_cache::drop_state() const {
+    std::error_code err;
+    fs::remove(fs::path(dir) / "link.state", err);
+}
+
+void sic::link_cache::write_state(const link_state &state) const {
+    byte_writer out;
+
+    out.put(STATE_MAGIC);
+    out.put(STATE_VERSION);
+    out.put(state.prog_addr);
+    out.put(state.total_len);
+
+    out.put<u32>(state.inputs.size());
+    for(const link_input &input : state.inputs) {
+        out.put(std::string_view(input.path));
+        out.put(input.hash);
+        out.put<u32>(input.lengths.size());
+        for(u32 len : input.lengths) out.put(len);
+    }
+
+    out.put<u32>(state.estab.size());
+    for(const auto &[sym, addr] : state.estab) {
+        out.put(sym);
+        out.put(addr);
+    }
+
+    out.put<u32>(state.written.size());
+    for(const interval &run : state.written) {
+        out.put(run.start);
+        out.put(run.end);
+    }
+
+    out.put(state.image.data(), state.image.size());
+
+    write_file((fs::path(dir) / "link.state").string(), out.bytes);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../core/defines.h"
+#include "../util/interval_set.h"
+
+namespace sic {
+
+struct object_file;
+
+// identifies the contents of an input file
+struct file_stamp {
+    u64 mtime = 0;
+    u64 size = 0;
+    u64 hash = 0; // fnv-1a of the contents
+};
+
+// one input of the last link, as it was then
+struct link_input {
+    string path;
+    u64 hash;
+    vector<u32> lengths; // its control sections, in order
+};
+
+// everything the last successful link produced
+struct link_state {
+    u32 prog_addr = 0;
+    u32 total_len = 0;
+
+    vector<link_input> inputs;
+    vector<std::pair<u64, u32>> estab; // packed symbol -> address
+    interval_set written;              // bytes of the image that were written
+    vector<u8> image;                  // those bytes, run after run
+};
+
+// on disk cache for incremental linking (link -c <dir>):
+//   <dir>/<hash of the path>.lko  one parsed object file + the stamp of the file it came from
+//   <dir>/link.state              the last successful link (inputs, layout, ESTAB, image)
+// anything that is missing, stale or doesn't look right is a miss, never an error.
+class link_cache
+{
+private:
+    string dir;
+
+    string object_path(const string &path) const;
+
+public:
+    link_cache(const string &dir);
+
+    // stamp of the file as it is now (mtime and size, no hash)
+    static file_stamp stat(const string &path);
+
+    // parsed copy of path, and the stamp of the file it was parsed from
+    bool read_object(const string &path, object_file &obj, file_stamp &stamp) const;
+    void write_object(const object_file &obj, const file_stamp &stamp) const;
+
+    bool read_state(link_state &state) const;
+    void write_state(const link_state &state) const;
+    void drop_state() const;
+};
+
+} // namespace sic
@@ -1,10 +1,12 @@
 #include "linker.h"
 
+#include <filesystem>
+
 // helpers
 
 
 // public functions
-sic::linker::linker() : prog_addr(0), cs_addr(0), total_len(0) {}
+sic::linker::linker() : prog_addr(0), cs_addr(0), total_len(0), entry_addr(0) {}
 
 void sic::linker::add_file(string filename) {
     obj_files.push_back(filename);
@@ -13,15 +15,35 @@ void sic::linker::add_file(string filename) {
 void sic::linker::run(u32 start_addr) {
     this->prog_addr = start_addr;
     
-    cli::init_progress_bar();
+    progress.start(quiet);
+
+    // the last link this cache saw (pass 2 may build on top of it)
+    has_previous = cache && cache->read_state(previous);
+    relinked = false;
+    mods_applied = 0;
+    words_patched = 0;
 
-    cli::draw_progress(0, 50,  "[linker] starting pass 1...");
+    stats.begin("pass1");
     pass1();
 
-    cli::draw_progress(50, 100, "[linker] starting pass 2...");
+    stats.begin("pass2");
     pass2();
 
-    cli::reset_terminal();
+    if(cache) {
+        stats.begin("cache");
+        save_state();
+    }
+
+    finish_stats();
+
+    // final state + terminal back to normal
+    progress.stop();
+
+    if(quiet) return;
+
+    if(relinked) {
+        LOGFMT("LINKER", "relinked from cache, ", reloaded, " of ", layout.size(), " sections reloaded");
+    }
     
     LOGFMT(
         "LINKER",
@@ -29,186 +51,482 @@ void sic::linker::run(u32 start_addr) {
     )
 }
 
-void sic::linker::write_memory_to_file(string filepath) {
+void sic::linker::write_memory_to_file(string filepath, image_format format) {
+    // pass 2 already built it in place
+    if(output && format == image_format::raw && filepath == output->filepath()) {
+        if(!quiet) LOGFMT("LINKER", "Memory dump saved to: ", CYAN_TEXT(filepath), "\n");
+        return;
+    }
+
+    stats.begin("write");
+
     ofstream out(filepath, std::ios::binary);
     
     if (!out.is_open()) {
         throw ylib::Error("Linker: Could not open output file " + filepath);
     }
 
-    // write raw binary memory
-    out.write(reinterpret_cast<const char*>(memory.data()), memory.size());
-    out.close();
+    switch (format)
+    {
+    case image_format::segmented:
+        write_segmented(out);
+        break;
+    case image_format::sparse:
+        write_sparse(out, filepath);
+        break;
+    default:
+        write_raw(out);
+        break;
+    }
+
+    if (!out) {
+        throw ylib::Error("Linker: Could not write output file " + filepath);
+    }
+
+    stats.end();
+
+    if(quiet) return;
 
     LOGFMT("LINKER", "Memory dump saved to: ", CYAN_TEXT(filepath), "\n");
 }
 
-void sic::linker::write_estab_to_file(string filepath) {
-    ofstream out(filepath);
+void sic::linker::write_raw(ofstream &out) {
+    // write raw binary memory [0, end of program), a block at a time
+    // (pages that were never written come out as the 0xFF fill)
+    u32 end = prog_addr + total_len;
+    vector<u8> block(64 * 1024);
 
-    if (!out.is_open()) {
-        throw ylib::Error("linker: Could not open export file " + filepath);
+    for(u32 addr = 0; addr < end; addr += block.size()) {
+        usize n = std::min<usize>(block.size(), end - addr);
+        memory.read(addr, block.data(), n);
+        out.write(reinterpret_cast<const char*>(block.data()), n);
+    }
+    out.close();
+}
+
+void sic::linker::write_segmented(ofstream &out) {
+    // layout (all little endian):
+    //   0   "SXSG"
+    //   4   u32 version (1)
+    //   8   u32 entry point
+    //   12  u32 load address (start of the program)
+    //   16  u32 program length
+    //   20  u32 segment count
+    //   24  segment table: {u32 addr, u32 size, u64 file offset} per segment
+    //   ... segment data, each one at a file offset that matches its address
+    //       modulo 4096, so a loader can mmap a segment straight to its address
+    constexpr u32 ALIGN = memory_image::PAGE_SIZE;
+
+    // written ranges. holes shorter than a page cost nothing extra (the alignment
+    // padding would take the same room), so they stay inside the segment as fill
+    vector<interval> segments;
+    memory.for_each_run(prog_addr, prog_addr + total_len, [&](u32 start, u32 end) {
+        if(!segments.empty() && start - segments.back().end < ALIGN) {
+            segments.back().end = end;
+        }
+        else {
+            segments.push_back({start, end});
+        }
+    });
+
+    vector<u8> header;
+    auto put32 = [&](u32 val) {
+        for(u32 i = 0; i < 4; i++) header.push_back((val >> (8 * i)) & 0xFF);
+    };
+
+    for(char c : {'S', 'X', 'S', 'G'}) header.push_back(c);
+    put32(1);
+    put32(entry_addr);
+    put32(prog_addr);
+    put32(total_len);
+    put32(segments.size());
+
+    u64 offset = header.size() + segments.size() * 16;
+    vector<u64> offsets;
+
+    for(const interval &seg : segments) {
+        offset += (seg.start - offset) & (ALIGN - 1);
+        offsets.push_back(offset);
+
+        put32(seg.start);
+        put32(seg.size());
+        put32((u32)offset);
+        put32((u32)(offset >> 32));
+
+        offset += seg.size();
     }
 
-    using std::left, std::setw, std::endl;
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    // data, padding with zeros up to each segment's offset
+    u64 at = header.size();
+    vector<u8> block(64 * 1024);
+
+    for(usize i = 0; i < segments.size(); i++) {
+        std::fill(block.begin(), block.end(), 0);
+        while(at < offsets[i]) {
+            usize n = std::min<u64>(block.size(), offsets[i] - at);
+            out.write(reinterpret_cast<const char*>(block.data()), n);
+            at += n;
+        }
+
+        for(u32 addr = segments[i].start; addr < segments[i].end;) {
+            usize n = std::min<usize>(block.size(), segments[i].end - addr);
+            memory.read(addr, block.data(), n);
+            out.write(reinterpret_cast<const char*>(block.data()), n);
+
+            addr += n;
+            at += n;
+        }
+    }
+    out.close();
+}
+
+void sic::linker::write_sparse(ofstream &out, const string &filepath) {
+    // same layout as raw, but pages with nothing written are skipped over, so the
+    // file system leaves holes there (they read back as 00, not as the 0xFF fill)
+    constexpr u32 PAGE = memory_image::PAGE_SIZE;
+    u32 end = prog_addr + total_len;
+
+    // pages that hold at least one written byte
+    vector<interval> pages;
+    memory.for_each_run(prog_addr, end, [&](u32 start, u32 run_end) {
+        u32 first = start & ~(PAGE - 1);
+        u32 last = std::min<u64>(end, ((u64)(run_end - 1) | (PAGE - 1)) + 1);
+
+        if(!pages.empty() && first <= pages.back().end) pages.back().end = std::max(pages.back().end, last);
+        else pages.push_back({first, last});
+    });
+
+    vector<u8> block(64 * 1024);
+    for(const interval &range : pages) {
+        out.seekp(range.start);
+
+        for(u32 addr = range.start; addr < range.end;) {
+            usize n = std::min<usize>(block.size(), range.end - addr);
+            memory.read(addr, block.data(), n);
+            out.write(reinterpret_cast<const char*>(block.data()), n);
+            addr += n;
+        }
+    }
+    out.close();
+
+    // a trailing hole only exists once the file has its full size
+    std::error_code err;
+    std::filesystem::resize_file(filepath, end, err);
+    if (err) {
+        throw ylib::Error("Linker: Could not write output file " + filepath);
+    }
+}
+
+void sic::linker::write_estab_to_file(string filepath) {
+    stats.begin("write");
+    file_writer out(filepath);
 
     // Header
-    out << left << setw(10) << "SYMBOL" 
-        << left << setw(10) << "ADDRESS" << endl;
-    out << "--------------------" << endl;
+    out.column("SYMBOL", 10);
+    out.column("ADDRESS", 10);
+    out.put('\n');
+    out.line("--------------------");
     
+    // sort by name only here (the keys compare like the names do)
+    vector<std::pair<u64, u32>> entries;
+    entries.reserve(estab.size());
+    estab.for_each([&](u64 sym, u32 addr) { entries.push_back({sym, addr}); });
+    std::sort(entries.begin(), entries.end());
+
     // Data
-    for (const auto &[sym, addr] : estab) {
-        out << left << setw(10) << sym 
-            << base::bintohex(addr, 6) << endl;
+    char name[8];
+    char addr_hex[8];
+    for (const auto &[sym, addr] : entries) {
+        char *addr_end = base::format_hex(addr_hex, addr, 6);
+
+        out.column(std::string_view(name, unpack_symbol(sym, name)), 10);
+        out.line(std::string_view(addr_hex, addr_end - addr_hex));
     }
     out.close();
+    stats.end();
+
+    if(quiet) return;
 
     LOGFMT("LINKER", "symbol table exported to: ", CYAN_TEXT(filepath), "\n");
 }
 
+map<string, u32> sic::linker::get_estab() const {
+    map<string, u32> table;
+    char name[8];
+
+    estab.for_each([&](u64 sym, u32 addr) {
+        table.emplace(string(name, unpack_symbol(sym, name)), addr);
+    });
+
+    return table;
+}
+
 // private functions
 void sic::linker::pass1() {
-    // start control section at the beginning
-    cs_addr = prog_addr;
+    // read every file exactly once (files are independent, so in parallel)
+    objects.clear();
+    objects.resize(obj_files.size());
 
-    for(const auto &filepath : obj_files) {
-        ifstream file(filepath);
-        if(!file.is_open()) {
-            throw ylib::Error("linker cannot open obj file at: " + filepath);
-        }
+    // with a cache, files that didn't change come back already parsed
+    vector<file_stamp> stamps(obj_files.size());
+    vector<char> stale(obj_files.size(), 0);
+
+    progress.phase("[linker] pass 1: reading objects...", obj_files.size());
+
+    auto read = [&](usize i) {
+        if(cache) stale[i] = load_object(obj_files[i], objects[i], stamps[i]);
+        else parse_object(obj_files[i], objects[i]);
 
-        string line;
-        u32 cs_len = 0; // length of this current file
-        
-        while(getline(file, line)) {
-            if(line.empty()) continue;
-
-            string clean_line = "";
-            for (char c : line) {
-                if (c != '^' && c != '\r') {
-                    clean_line += c;
-                }
-            }
-
-            if(clean_line.empty()) continue;
-
-            switch (clean_line[0])
-            {
-            case 'H':
-                parse_header(clean_line, cs_len);
-                break;
-            case 'D':
-                parse_define(clean_line);
-                break;
-            case 'E':
-                break;
-            default:
-                break;
-            }
+        progress.advance();
+    };
+
+    if(threads > 1 && obj_files.size() > 1) {
+        thread_pool pool(std::min<usize>(threads, obj_files.size()));
+        pool.parallel_for(obj_files.size(), read);
+    }
+    else {
+        for(usize i = 0; i < obj_files.size(); i++) read(i);
+    }
+
+    // store what had to be parsed again (one at a time, the same file may be listed twice)
+    cached_objects = 0;
+    for(usize i = 0; i < obj_files.size(); i++) {
+        if(cache && !stale[i]) cached_objects++;
+        if(!stale[i]) continue;
+
+        try {
+            cache->write_object(objects[i], stamps[i]);
+        }
+        catch(const ylib::Error &err) {
+            LOGFMT("LINKER", YELLOW_TEXT("Warning: "), err.what());
         }
+    }
 
-        file.close();
+    // lay the sections out one after another: base = prog_addr + lengths of the ones before
+    layout.clear();
+    cs_addr = prog_addr;
 
-        // advance to the next available memory slot
-        cs_addr += cs_len;
+    for(auto &obj : objects) {
+        for(auto &cs : obj.sections) {
+            cs.base = cs_addr;
+            cs_addr += cs.length;
+
+            layout.push_back({&obj, &cs, {}, {}});
+        }
     }
 
     total_len = cs_addr - prog_addr;
+
+    // execution starts where the first E record with an address says (else at the start)
+    entry_addr = prog_addr;
+    for(auto &sec : layout) {
+        if(sec.cs->has_entry) {
+            entry_addr = sec.cs->base + sec.cs->entry;
+            break;
+        }
+    }
+
+    // merge the names and D records into ESTAB (in load order, so the
+    // duplicate that gets reported doesn't depend on thread timing)
+    estab.clear();
+
+    for(auto &sec : layout) {
+        place_section(*sec.obj, *sec.cs);
+    }
 }
 
 void sic::linker::pass2() {
-    // reset to start
-    cs_addr = prog_addr;
-
-    // alloc memory -> clear + resize and fill with garbage (0xFF)
+    // reset memory -> pages are allocated (filled with 0xFF garbage) on first write
     memory.clear();
-    memory.resize(prog_addr + total_len, 0xFF);
 
-    for(auto const &filepath : obj_files) {
-        ifstream file(filepath);
-        if(!file.is_open()) {
-            throw ylib::Error("linker pass 2 cannot open obj file at: " + filepath);
+    // or they are pieces of the output file, which is the raw image [0, end of program)
+    if(!mapped_path.empty()) {
+        output.reset();
+        output = std::make_unique<mapped_output>(mapped_path, prog_addr + total_len);
+
+        if(output->bytes()) memory.attach(output->bytes(), output->length());
+    }
+
+    progress.phase("[linker] pass 2: loading sections...", layout.size());
+
+    // 1. checks, symbol lookups, error messages and page allocation, all in load order
+    disjoint = true;
+    for(auto &sec : layout) {
+        disjoint &= prepare_section(sec);
+    }
+
+    // same inputs and layout as the last link -> only redo what changed
+    if(disjoint && can_relink()) {
+        relink();
+        return;
+    }
+
+    // 2. sections write disjoint ranges of memory (unless some record reaches outside
+    //    its own section, then the load order matters and it stays sequential)
+    if(threads > 1 && disjoint && layout.size() > 1) {
+        thread_pool pool(std::min<usize>(threads, layout.size()));
+        pool.parallel_for(layout.size(), [&](usize i) {
+            load_section(layout[i]);
+            progress.advance();
+        });
+    }
+    else {
+        for(auto &sec : layout) {
+            load_section(sec);
+            progress.advance();
         }
+    }
 
-        string line;
-        u32 curr_cs_len = 0;
-        while(getline(file, line)) {
-            if(line.empty()) continue;
-
-            string clean_line = "";
-            for (char c : line) {
-                if (c != '^' && c != '\r') {
-                    clean_line += c;
-                }
-            }
-
-            if(clean_line.empty()) continue;
-
-            char rec = clean_line[0];
-
-            if(rec == 'H') {
-                string len_str = clean_line.substr(13, 6);
-                curr_cs_len = base::hextobin<u32>(len_str);
-            }
-            else if(rec == 'T') {
-                parse_text(clean_line);
-            }
-            else if(rec == 'M') {
-                parse_modify(clean_line);
-            }
+    // 3. init bits share words across sections, set them in one go
+    for(const auto &sec : layout) {
+        for(const interval &run : sec.written) {
+            memory.mark(run.start, run.size());
         }
+    }
+}
 
-        file.close();
+void sic::linker::finish_stats() {
+    stats.end();
 
-        // advance to next memory slot
-        cs_addr += curr_cs_len;
+    u64 defines = 0, texts = 0, modifies = 0, bytes_loaded = 0;
+    for(const auto &obj : objects) {
+        defines += obj.defines.size();
+        texts += obj.texts.size();
+        modifies += obj.modifies.size();
+        for(const auto &text : obj.texts) bytes_loaded += text.len;
     }
+
+    stats.set("objects", objects.size());
+    stats.set("objects_cached", cached_objects);
+    stats.set("records_h", layout.size()); // one section per H record
+    stats.set("records_d", defines);
+    stats.set("records_t", texts);
+    stats.set("records_m", modifies);
+    stats.set("bytes_loaded", bytes_loaded);
+    stats.set("mods_applied", mods_applied);
+    stats.set("words_patched", words_patched.load());
+    stats.set("symbols", estab.size());
+    stats.set("image_bytes", total_len);
+    if(relinked) stats.set("sections_reloaded", reloaded);
 }
 
-// parsing records
-void sic::linker::parse_header(string record, u32 &curr_cs_len) {
-    // H ^ PROGNAME ^ START ^ LENGTH
-    // 0   1          7       13
+// --- pass 1: parsing ---
+void sic::linker::parse_object(const string &filepath, object_file &obj) {
+    obj.path = filepath;
 
-    string prog_name = sic::trim(record.substr(1, 6));
+    mapped_file file(filepath);
+    parse_records(file.view(), obj);
+}
 
-    // maps prog_name -> start address of current control section
-    if(!prog_name.empty()) {
-        if(estab.count(prog_name) > 0) {
-            throw ylib::Error("duplicate global symbol: " + prog_name);
+bool sic::linker::load_object(const string &filepath, object_file &obj, file_stamp &stamp) const {
+    // returns true if the cache entry has to be (re)written
+    file_stamp now = link_cache::stat(filepath);
+    bool cached = cache->read_object(filepath, obj, stamp);
+
+    // untouched since it was cached, don't even open it
+    if(cached && now.mtime != 0 && now.mtime == stamp.mtime && now.size == stamp.size) {
+        return false;
+    }
+
+    mapped_file file(filepath);
+    now.hash = base::fnv1a(file.view());
+
+    // touched, but the same contents
+    if(cached && now.hash == stamp.hash) {
+        stamp = now;
+        return true;
+    }
+
+    obj = object_file();
+    obj.path = filepath;
+    obj.hash = now.hash;
+    parse_records(file.view(), obj);
+
+    stamp = now;
+    return true;
+}
+
+void sic::linker::parse_records(std::string_view text, object_file &obj) {
+    record_reader reader(text);
+
+    record rec;
+    while(reader.next(rec)) {
+        char type = rec.type();
+
+        // records before the first H still belong somewhere
+        if(type != 'H' && obj.sections.empty()) {
+            obj.sections.emplace_back();
         }
 
-        estab[prog_name] = cs_addr;
+        switch (type)
+        {
+        case 'H':
+            parse_header(rec, obj);
+            break;
+        case 'D':
+            parse_define(rec, obj);
+            break;
+        case 'T':
+            parse_text(rec, obj);
+            break;
+        case 'M':
+            parse_modify(rec, obj);
+            break;
+        case 'E':
+            parse_end(rec, obj);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // ranges close where the next section starts
+    for(usize i = 0; i < obj.sections.size(); i++) {
+        control_section &cs = obj.sections[i];
+        bool last = i + 1 == obj.sections.size();
+
+        cs.defines.count  = (last ? obj.defines.size()  : obj.sections[i + 1].defines.first)  - cs.defines.first;
+        cs.texts.count    = (last ? obj.texts.size()    : obj.sections[i + 1].texts.first)    - cs.texts.first;
+        cs.modifies.count = (last ? obj.modifies.size() : obj.sections[i + 1].modifies.first) - cs.modifies.first;
     }
+}
+
+void sic::linker::parse_header(const record &rec, object_file &obj) {
+    // H ^ PROGNAME ^ START ^ LENGTH
+    // 0   1          7       13
 
-    string len_str = record.substr(13, 6);
-    curr_cs_len = base::hextobin<u32>(len_str);
+    control_section cs;
+    cs.name = pack_symbol(trim_view(rec.field(1, 6)));
+    cs.length = base::hextobin<u32>(rec.field(13, 6));
+
+    // this section's records start here
+    cs.defines.first = obj.defines.size();
+    cs.texts.first = obj.texts.size();
+    cs.modifies.first = obj.modifies.size();
+
+    obj.sections.push_back(cs);
 }
 
-void sic::linker::parse_define(string record) {
+void sic::linker::parse_define(const record &rec, object_file &obj) {
     // D ^ SYM1 ^ ADDR1 ^ SYM2 ^ ADDR2 ...
     // starts at idx = 1. pairs of 12 chars = [symbol(6), addr(6)]
     
     u64 idx = 1;
+    u64 len = rec.length();
     
     // loop over each entry until we run out
-    while(idx + 12 <= record.length()) {
+    while(idx + 12 <= len) {
 
         // extract symbol
-        string sym = sic::trim(record.substr(idx, 6));
+        std::string_view sym = trim_view(rec.field(idx, 6));
 
         // extract relative address
-        string addr_str = record.substr(idx + 6, 6);
-        u32 rel_addr = base::hextobin<u32>(addr_str);
+        u32 rel_addr = base::hextobin<u32>(rec.field(idx + 6, 6));
 
-        // calc absolute address
         if(!sym.empty()) {
-            if(estab.count(sym) > 0) {
-                throw ylib::Error("duplicate global symbol: " + sym);
-            }
-
-            estab[sym] = cs_addr + rel_addr;
+            obj.defines.push_back({pack_symbol(sym), rel_addr});
         }
 
         // move to next entry
@@ -216,92 +534,249 @@ void sic::linker::parse_define(string record) {
     }
 }
 
-void sic::linker::parse_text(string record) {
+void sic::linker::parse_text(const record &rec, object_file &obj) {
     // T ^ START ^ LEN ^ CODE...
     // 0   1       7     9
 
-    // get start addr (relative to file)
-    string start_str = record.substr(1, 6);
-    u32 rel_addr = base::hextobin<u32>(start_str);
+    // get start addr (relative to the section)
+    u32 rel_addr = base::hextobin<u32>(rec.field(1, 6));
 
     // get length
-    string len_str = record.substr(7, 2);
-    u32 len = base::hextobin<u32>(len_str);
-
-    // get code
-    string objcode = record.substr(9);
+    u32 len = base::hextobin<u32>(rec.field(7, 2));
 
-    for(u32 i = 0; i < len; i++) {
-        // safety
-        if((2 * i) + 2 > objcode.length()) break;
+    // decode the code once, pass 2 only copies it (one byte per pair of hex digits)
+    u8 *bytes = obj.storage.alloc_array<u8>(std::max<u32>(len, 1));
 
-        string byte_str = objcode.substr(2 * i, 2);
-        u8 val = base::hextobin<u8>(byte_str);
+    usize valid = 0;
+    usize decoded = rec.decode_hex(9, len, bytes, nullptr, &valid);
 
-        // physical address
-        u32 phys_addr = cs_addr + rel_addr + i;
-
-        if(phys_addr < memory.size()) {
-            memory[phys_addr] = val;
-        }
-        else {
-            LOGFMT("LINKER", RED_TEXT("Fatal Error: Memory Overflow"));
-            throw ylib::Error("sicxe memory overflow");
-        }
+    if(valid != decoded) {
+        throw ylib::Error("linker: invalid hex digits in T record: " + string(rec.raw));
     }
+
+    obj.texts.push_back({rel_addr, (u32)decoded, bytes});
 }
 
-void sic::linker::parse_modify(string record) {
+void sic::linker::parse_modify(const record &rec, object_file &obj) {
     // M ^ ADDR ^ LEN ^ SIGN ^ SYMBOL
     // 0   1      7     9      10
 
+    modify_entry mod;
+
     // address to mod
-    string addr_str = record.substr(1, 6);
-    u32 rel_addr = base::hextobin<u32>(addr_str);
+    mod.rel_addr = base::hextobin<u32>(rec.field(1, 6));
 
     // length (in half-bytes/nibbles)
-    string len_str = record.substr(7, 2);
-    u32 len_nibbles = base::hextobin<u32>(len_str);
+    mod.len_nibbles = base::hextobin<u8>(rec.field(7, 2));
 
     // sign (+ or -)
-    char sign = record[9];
+    std::string_view sign_str = rec.field(9, 1);
+    mod.sign = sign_str.empty() ? '+' : sign_str[0];
 
     // symbol to plus/minus
-    string sym = sic::trim(record.substr(10));
+    std::string_view sym = trim_view(rec.field(10));
+    mod.symbol = pack_symbol(sym);
+    mod.symbol_text = obj.storage.copy(sym);
+
+    obj.modifies.push_back(mod);
+}
 
-    // apply the mod
-    apply_mod(cs_addr + rel_addr, len_nibbles, sign, sym);
+void sic::linker::parse_end(const record &rec, object_file &obj) {
+    // E ^ FIRST
+    // 0   1
+    // (only the main section names its first instruction)
+    std::string_view first = trim_view(rec.field(1, 6));
+    if(first.empty()) return;
 
+    control_section &cs = obj.sections.back();
+    cs.has_entry = true;
+    cs.entry = base::hextobin<u32>(first);
 }
 
-void sic::linker::apply_mod(u32 addr, u32 len_nibbles, char sign, string sym) {
-    // validate symbol
-    if(estab.count(sym) == 0) {
-        LOGFMT("LINKER", RED_TEXT("Error: Undefined Global Symbol: ") + sym)
-        return;
+void sic::linker::place_section(const object_file &obj, control_section &cs) {
+    // maps prog_name -> start address of current control section
+    if(cs.name != 0) {
+        define_symbol(cs.name, cs.base);
     }
 
-    u32 sym_val = estab[sym];
+    // D records: calc absolute addresses
+    for(u32 i = 0; i < cs.defines.count; i++) {
+        const define_entry &def = obj.defines[cs.defines.first + i];
+        define_symbol(def.symbol, cs.base + def.rel_addr);
+    }
+}
+
+void sic::linker::define_symbol(u64 symbol, u32 addr) {
+    // one probe: inserts, or finds the one already there
+    if(!estab.insert(symbol, addr).second) {
+        char name[8];
+        throw ylib::Error("duplicate global symbol: " + string(name, unpack_symbol(symbol, name)));
+    }
+}
+
+// --- pass 2: loading ---
+bool sic::linker::prepare_section(placed_section &sec) {
+    const object_file &obj = *sec.obj;
+    const control_section &cs = *sec.cs;
+
+    u32 cs_end = cs.base + cs.length;
+    bool inside = true; // every record stays within this section
+
+    for(u32 i = 0; i < cs.texts.count; i++) {
+        const text_chunk &text = obj.texts[cs.texts.first + i];
+
+        // physical address
+        u32 phys_addr = cs.base + text.rel_addr;
+
+        if(phys_addr + text.len > prog_addr + total_len) {
+            LOGFMT("LINKER", RED_TEXT("Fatal Error: Memory Overflow"));
+            throw ylib::Error("sicxe memory overflow");
+        }
+
+        inside &= phys_addr + text.len <= cs_end;
+        memory.reserve(phys_addr, text.len);
+    }
+
+    sec.mods.clear();
+    sec.mods.reserve(cs.modifies.count);
+
+    for(u32 i = 0; i < cs.modifies.count; i++) {
+        const modify_entry &entry = obj.modifies[cs.modifies.first + i];
+
+        resolved_mod mod;
+        if(!resolve_mod(cs.base + entry.rel_addr, entry, mod)) {
+            continue;
+        }
+
+        mod.order = i;
+        inside &= mod.addr + 3 <= cs_end;
+        memory.reserve(mod.addr, 3);
+        sec.mods.push_back(mod);
+    }
+
+    mods_applied += sec.mods.size();
+    sort_mods(sec.mods);
+
+    return inside;
+}
+
+void sic::linker::load_section(placed_section &sec) {
+    const object_file &obj = *sec.obj;
+    const control_section &cs = *sec.cs;
+
+    sec.written.clear();
+
+    // T records: copy the decoded payloads
+    for(u32 i = 0; i < cs.texts.count; i++) {
+        const text_chunk &text = obj.texts[cs.texts.first + i];
+        u32 phys_addr = cs.base + text.rel_addr;
+
+        memory.poke(phys_addr, text.bytes, text.len);
+        sec.written.add(phys_addr, phys_addr + text.len);
+    }
+
+    // then the modifications
+    apply_mods(sec.mods, sec.written);
+}
+
+void sic::linker::apply_mods(const vector<resolved_mod> &mods, interval_set &written) {
+    // one pass in address order (see sort_mods)
+    for(const resolved_mod &mod : mods) {
+        usize avail;
+        u8 *word = memory.span(mod.addr, avail); // page is reserved, only a lookup
+
+        if(avail >= 3) {
+            write_word(word, apply_mod(read_word(word), mod));
+        }
+        else {
+            // word crosses a page boundary
+            u8 bytes[3];
+            memory.read(mod.addr, bytes, 3);
+            write_word(bytes, apply_mod(read_word(bytes), mod));
+            memory.poke(mod.addr, bytes, 3);
+        }
+
+        written.add(mod.addr, mod.addr + 3);
+    }
+
+    words_patched.fetch_add(mods.size(), std::memory_order_relaxed);
+}
+
+void sic::linker::sort_mods(vector<resolved_mod> &mods) {
+    // stable: M records on the same word keep their order
+    std::stable_sort(mods.begin(), mods.end(),
+                     [](const resolved_mod &a, const resolved_mod &b) { return a.addr < b.addr; });
+
+    // words that partly overlap (addresses 1 or 2 apart) carry into each other,
+    // so the order they were written in matters: leave those in record order
+    for(usize i = 1; i < mods.size(); i++) {
+        u32 gap = mods[i].addr - mods[i - 1].addr;
+        if(gap > 0 && gap < 3) {
+            std::sort(mods.begin(), mods.end(),
+                      [](const resolved_mod &a, const resolved_mod &b) { return a.order < b.order; });
+            return;
+        }
+    }
+
+    // the same word modified the same way several times (+A, -B, ...) -> one sum
+    usize kept = 0;
+    for(usize i = 0; i < mods.size(); i++) {
+        if(kept > 0 && mods[kept - 1].addr == mods[i].addr && mods[kept - 1].len_nibbles == mods[i].len_nibbles) {
+            mods[kept - 1].delta += mods[i].delta;
+        }
+        else {
+            mods[kept++] = mods[i];
+        }
+    }
+    mods.resize(kept);
+}
+
+
+bool sic::linker::resolve_mod(u32 addr, const modify_entry &entry, resolved_mod &mod) {
+    u32 len_nibbles = entry.len_nibbles;
+
+    // validate symbol (0 = empty or too long, never defined)
+    const u32 *sym_addr = entry.symbol ? estab.find(entry.symbol) : nullptr;
+    if(!sym_addr) {
+        LOGFMT("LINKER", RED_TEXT("Error: Undefined Global Symbol: ") + string(entry.symbol_text))
+        return false;
+    }
+
+    u32 sym_val = *sym_addr;
 
     // check bounds
-    if(addr + 2 >= memory.size()) {
+    if(addr + 2 >= prog_addr + total_len) {
+        char addr_hex[8];
+        char *addr_end = base::format_hex(addr_hex, addr, 6);
+
         LOGFMT(
             "LINKER",
             RED_TEXT("Error: Modification out of bounds at "),
-            base::bintohex(addr, 6)
+            std::string_view(addr_hex, addr_end - addr_hex)
         )
 
-        return;
+        return false;
     }
 
-    // read data (big endian)
-    u32  b1 = memory[addr]; // not u8 cuz we are shifting by 16
-    u16  b2 = memory[addr + 1];
-    u8   b3 = memory[addr + 2];
+    // fmt 4 address (5) or a whole word (6)
+    if(len_nibbles != 5 && len_nibbles != 6) {
+        LOGFMT(
+            "LINKER", 
+            YELLOW_TEXT("Warning: Unsupported M record length: "),
+            len_nibbles
+        );
+
+        return false;
+    }
 
-    u32 curr_val = (b1 << 16) | (b2 << 8) | b3;
+    mod.addr = addr;
+    mod.delta = entry.sign == '+' ? sym_val : -sym_val;
+    mod.len_nibbles = len_nibbles;
+    return true;
+}
 
-    if(len_nibbles == 5) {
+u32 sic::linker::apply_mod(u32 curr_val, const resolved_mod &mod) {
+    if(mod.len_nibbles == 5) {
         // fmt 4 address
         // only handle least 20 bits
         // don't touch most 4 bits (xbpe flags)
@@ -313,32 +788,175 @@ void sic::linker::apply_mod(u32 addr, u32 len_nibbles, char sign, string sym) {
         u32 addr_field = curr_val & addr_mask;
 
         // symbol calc
-        addr_field += (sign == '+' ? sym_val : -sym_val);
+        addr_field += mod.delta;
 
         addr_field &= addr_mask; // reapply the mask just in case
 
         // put it together
-        curr_val = flags | addr_field;
+        return flags | addr_field;
     }
-    else if(len_nibbles == 6) {
-        // standard word (24 bits)
 
-        curr_val += (sign == '+' ? sym_val : -sym_val);
+    // standard word (24 bits)
+    return (curr_val + mod.delta) & 0xFFFFFF; // keep as 24 bits
+}
+
+// --- incremental relink ---
+bool sic::linker::can_relink() const {
+    // the image only stays valid if every section sits where it did last time
+    if(!has_previous || previous.prog_addr != prog_addr || previous.total_len != total_len) return false;
+    if(previous.inputs.size() != objects.size()) return false;
+
+    for(usize i = 0; i < objects.size(); i++) {
+        const link_input &input = previous.inputs[i];
+        const object_file &obj = objects[i];
+
+        if(input.path != obj.path || input.lengths.size() != obj.sections.size()) return false;
 
-        curr_val &= 0xFFFFFF; // keep as 24 bits
+        for(usize k = 0; k < obj.sections.size(); k++) {
+            if(input.lengths[k] != obj.sections[k].length) return false;
+        }
     }
-    else {
-        LOGFMT(
-            "LINKER", 
-            YELLOW_TEXT("Warning: Unsupported M record length: "),
-            len_nibbles
-        );
 
+    return true;
+}
+
+void sic::linker::relink() {
+    // start from the image of the last link
+    usize at = 0;
+    for(const interval &run : previous.written) {
+        memory.write(run.start, previous.image.data() + at, run.size());
+        at += run.size();
+    }
+
+    flat_map<u64, u32> old_estab;
+    old_estab.reserve(previous.estab.size());
+    for(const auto &[sym, addr] : previous.estab) old_estab.insert(sym, addr);
+
+    relinked = true;
+    reloaded = 0;
+    for(auto &sec : layout) {
+        usize idx = sec.obj - objects.data();
+
+        // changed files are loaded again, the rest only get their M records fixed up
+        if(sec.obj->hash != previous.inputs[idx].hash) {
+            reload_section(sec);
+            reloaded++;
+        }
+        else if(patch_section(sec, old_estab)) {
+            reloaded++;
+        }
+
+        progress.advance();
+    }
+
+}
+
+void sic::linker::reload_section(placed_section &sec) {
+    // sections are disjoint, so the old bytes of this one are exactly its range
+    memory.reset(sec.cs->base, sec.cs->length);
+    load_section(sec);
+
+    for(const interval &run : sec.written) {
+        memory.mark(run.start, run.size());
+    }
+}
+
+bool sic::linker::patch_section(placed_section &sec, const flat_map<u64, u32> &old_estab) {
+    // returns true if the section had to be reloaded after all
+    const object_file &obj = *sec.obj;
+    const control_section &cs = *sec.cs;
+
+    // what an M record adds with a given ESTAB (undefined symbols add nothing)
+    auto added = [](const flat_map<u64, u32> &table, const modify_entry &entry) -> u32 {
+        const u32 *sym = entry.symbol ? table.find(entry.symbol) : nullptr;
+        if(!sym) return 0;
+        return entry.sign == '+' ? *sym : -*sym;
+    };
+
+    vector<resolved_mod> patch;
+    vector<std::pair<u32, u8>> words; // every applicable M record: addr, length
+
+    for(u32 i = 0; i < cs.modifies.count; i++) {
+        const modify_entry &entry = obj.modifies[cs.modifies.first + i];
+        u32 addr = cs.base + entry.rel_addr;
+
+        // the records resolve_mod rejects whatever the symbol (already reported)
+        if(addr + 2 >= prog_addr + total_len) continue;
+        if(entry.len_nibbles != 5 && entry.len_nibbles != 6) continue;
+
+        words.push_back({addr, entry.len_nibbles});
+
+        u32 now = added(estab, entry);
+        u32 before = added(old_estab, entry);
+
+        if(now != before) {
+            patch.push_back({addr, now - before, i, entry.len_nibbles});
+        }
+    }
+
+    if(patch.empty()) return false;
+
+    // fixing a word up by the difference only works if nothing else touches
+    // its bytes (see sort_mods), otherwise build the section again
+    std::sort(words.begin(), words.end());
+    for(usize i = 1; i < words.size(); i++) {
+        u32 gap = words[i].first - words[i - 1].first;
+
+        if(gap < 3 && !(gap == 0 && words[i].second == words[i - 1].second)) {
+            reload_section(sec);
+            return true;
+        }
+    }
+
+    for(const resolved_mod &mod : patch) {
+        memory.reserve(mod.addr, 3);
+    }
+
+    sort_mods(patch);
+
+    interval_set written;
+    apply_mods(patch, written);
+
+    for(const interval &run : written) {
+        memory.mark(run.start, run.size());
+    }
+
+    return false;
+}
+
+void sic::linker::save_state() {
+    // an image where some section wrote into another can't be patched later
+    if(!disjoint) {
+        cache->drop_state();
         return;
     }
 
-    // write to mem (big endian)
-    memory[addr]     = (curr_val >> 16) & 0xFF;
-    memory[addr + 1] = (curr_val >> 8)  & 0xFF;
-    memory[addr + 2] =  curr_val        & 0xFF;
+    link_state state;
+    state.prog_addr = prog_addr;
+    state.total_len = total_len;
+
+    for(const auto &obj : objects) {
+        link_input input{obj.path, obj.hash, {}};
+        for(const auto &cs : obj.sections) input.lengths.push_back(cs.length);
+
+        state.inputs.push_back(std::move(input));
+    }
+
+    estab.for_each([&](u64 sym, u32 addr) { state.estab.push_back({sym, addr}); });
+
+    // the written bytes of the program, run by run
+    memory.for_each_run(prog_addr, prog_addr + total_len, [&](u32 start, u32 end) {
+        state.written.add(start, end);
+
+        usize old_size = state.image.size();
+        state.image.resize(old_size + (end - start));
+        memory.read(start, state.image.data() + old_size, end - start);
+    });
+
+    try {
+        cache->write_state(state);
+    }
+    catch(const ylib::Error &err) {
+        LOGFMT("LINKER", YELLOW_TEXT("Warning: "), err.what());
+    }
 }
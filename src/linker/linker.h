@@ -3,8 +3,20 @@
 #include "../core/logger.h"
 #include "../core/error.h"
 
+#include "../util/arena.h"
 #include "../util/base.h"
 #include "../util/cli.h"
+#include "../util/file_writer.h"
+#include "../util/flat_map.h"
+#include "../util/hex.h"
+#include "../util/interval_set.h"
+#include "../util/mapped_output.h"
+#include "../util/memory_image.h"
+#include "../util/record_reader.h"
+#include "../util/stats.h"
+#include "../util/thread_pool.h"
+
+#include "link_cache.h"
 
 namespace sic {
 
@@ -18,46 +30,218 @@ inline static string trim(const string& str) {
     return str.substr(first, (last - first + 1));
 }
 
+// --- external symbols ---
+
+// SIC/XE names are at most 6 chars, so a name fits in a u64: first char in the
+// top byte, zero padded. comparing two keys compares the names (sorted ESTAB = sorted keys).
+// 0 is the empty name, and is also what names too long to pack get (never defined).
+inline u64 pack_symbol(std::string_view name) {
+    if(name.size() > 8) return 0;
+
+    u64 key = 0;
+    for(usize i = 0; i < 8; i++) {
+        key = (key << 8) | (i < name.size() ? (u8)name[i] : 0);
+    }
+    return key;
+}
+
+// writes the name of key into out (8 chars of room), returns its length
+inline usize unpack_symbol(u64 key, char *out) {
+    usize len = 0;
+    for(; len < 8; len++) {
+        char c = (char)(key >> (56 - 8 * len));
+        if(c == 0) break;
+        out[len] = c;
+    }
+    return len;
+}
+
+// --- parsed object files (pass 1 reads every file once, pass 2 replays from memory) ---
+
+// D record entry: symbol defined at an offset of its control section
+struct define_entry {
+    u64 symbol; // packed
+    u32 rel_addr;
+};
+
+// T record, payload already decoded
+struct text_chunk {
+    u32 rel_addr;
+    u32 len;
+    const u8 *bytes; // len bytes in the file's arena
+};
+
+// M record
+struct modify_entry {
+    u32 rel_addr;
+    u8 len_nibbles;
+    char sign;
+    u64 symbol;                   // packed
+    std::string_view symbol_text; // trimmed, for error messages (points into the file's arena)
+};
+
+// [first, first + count) of one of the record vectors of an object_file
+struct record_range {
+    u32 first = 0;
+    u32 count = 0;
+};
+
+// one H ... E block
+struct control_section {
+    u64 name = 0;          // packed program name
+    u32 length = 0;
+    u32 base = 0;          // load address, set when pass 1 places the section
+
+    record_range defines;
+    record_range texts;
+    record_range modifies;
+
+    bool has_entry = false; // E record named the first instruction
+    u32 entry = 0;          // its address, relative to the section
+};
+
+struct object_file {
+    string path;
+    u64 hash = 0;  // fnv-1a of the contents (only filled when linking with a cache)
+    arena storage; // names and T payloads
+
+    vector<control_section> sections;
+    vector<define_entry> defines;
+    vector<text_chunk> texts;
+    vector<modify_entry> modifies;
+};
+
+// M record ready to apply: absolute address, symbol already resolved
+struct resolved_mod {
+    u32 addr;
+    u32 delta; // +/- symbol value (wraps, only the low bits are used)
+    u32 order; // index of the M record in its section
+    u8 len_nibbles;
+};
+
+// 24 bit big endian word
+inline u32 read_word(const u8 *bytes) {
+    return ((u32)bytes[0] << 16) | ((u32)bytes[1] << 8) | bytes[2];
+}
+
+inline void write_word(u8 *bytes, u32 val) {
+    bytes[0] = (val >> 16) & 0xFF;
+    bytes[1] = (val >> 8)  & 0xFF;
+    bytes[2] =  val        & 0xFF;
+}
+
+// a control section in load order, with what pass 2 needs for it
+struct placed_section {
+    const object_file *obj;
+    control_section *cs;
+
+    vector<resolved_mod> mods; // its M records that passed the checks, sorted by address
+    interval_set written;      // bytes its T/M records wrote (marked once pass 2 is done)
+};
+
+// how write_memory_to_file lays the image out
+enum class image_format : u8 {
+    raw,       // every byte from address 0 to the end of the program
+    segmented, // small header + only the written address ranges (see write_segmented)
+    sparse,    // raw, but pages nobody wrote are holes in the file
+};
+
 class linker{
 private:
     vector<string> obj_files;
+    vector<object_file> objects;   // obj_files, parsed (filled by pass 1)
+    vector<placed_section> layout; // every section, in load order
+
+    u32 threads = 1; // 1 = sequential
+    bool quiet = false; // no progress bar / success message
+
+    ::cli::progress progress; // objects read (pass 1), sections loaded (pass 2)
 
-    map<string, u32> estab; // external symbol table
-    vector<u8> memory; // final memory (including all progs)
+    // phase timings + tallies for --stats
+    run_stats stats;
+    u32 cached_objects = 0;             // pass 1 took them from the cache
+    u64 mods_applied = 0;               // M records that resolved (pass 2 checks, sequential)
+    std::atomic<u64> words_patched {0}; // words they changed, same address ones merged (parallel loads)
+
+    void finish_stats();
+
+    std::unique_ptr<link_cache> cache; // null = no cache, full link every time
+    link_state previous;               // what the cache says the last link produced
+    bool has_previous = false;
+    bool disjoint = false;             // every section only wrote its own range (pass 2)
+    bool relinked = false;             // pass 2 patched the previous image
+    u32 reloaded = 0;                  // sections it had to load again
+
+    flat_map<u64, u32> estab; // external symbol table, packed name -> address (unordered)
+    string mapped_path;                     // build the image right in this file (raw format)
+    std::unique_ptr<mapped_output> output;  // its mapping, outlives memory (declared before it)
+    memory_image memory{0xFF}; // final memory (including all progs), unwritten bytes read as garbage (0xFF)
 
     // state vars
     u32 prog_addr;  // starting addr for the whole program (combined)
     u32 cs_addr;    // starting addr of the current control section (file)
     u32 total_len;  // total length of the linked program
+    u32 entry_addr; // first instruction (E record of the first section that has one)
 
     // helpers
     void pass1();
     void pass2();
 
-    // pass 1 -> record parsers
-    void parse_header(string record, u32 &curr_cs_len);
-    void parse_define(string record);
-
-    // pass 2 -> record parsers
-    void parse_text(string record);
-    void parse_modify(string record);
+    // pass 1 -> parse a file into memory, then place its sections
+    static void parse_object(const string &filepath, object_file &obj);
+    static void parse_records(std::string_view text, object_file &obj);
+    bool load_object(const string &filepath, object_file &obj, file_stamp &stamp) const;
+    static void parse_header(const record &rec, object_file &obj);
+    static void parse_define(const record &rec, object_file &obj);
+    static void parse_text(const record &rec, object_file &obj);
+    static void parse_modify(const record &rec, object_file &obj);
+    static void parse_end(const record &rec, object_file &obj);
+    void place_section(const object_file &obj, control_section &cs);
+    void define_symbol(u64 symbol, u32 addr);
+
+    // pass 2 -> check and resolve a section (sequential), then replay it into memory
+    bool prepare_section(placed_section &sec);
+    void load_section(placed_section &sec);
+    void apply_mods(const vector<resolved_mod> &mods, interval_set &written);
+
+    // incremental pass 2 (on top of the previous image, see link_cache)
+    bool can_relink() const;
+    void relink();
+    void reload_section(placed_section &sec);
+    bool patch_section(placed_section &sec, const flat_map<u64, u32> &old_estab);
+    void save_state();
+
+    // output formats
+    void write_raw(ofstream &out);
+    void write_segmented(ofstream &out);
+    void write_sparse(ofstream &out, const string &filepath);
 
     // helper for modification recs (nibble = half byte)
-    void apply_mod(u32 addr, u32 len_nibbles, char sign, string symbol);
+    bool resolve_mod(u32 addr, const modify_entry &entry, resolved_mod &mod);
+    static void sort_mods(vector<resolved_mod> &mods);
+    static u32 apply_mod(u32 word, const resolved_mod &mod);
 
 public:
     linker();
 
     void add_file(string filename);
+    void set_threads(u32 count) { threads = count ? count : (u32)thread_pool::default_threads(); }
+    void set_quiet(bool q) { quiet = q; }
+    void set_cache(const string &dir) { cache = std::make_unique<link_cache>(dir); }
+    void map_output(const string &filepath) { mapped_path = filepath; }
     void run(u32 start_addr = 0x00000);
 
-    void write_memory_to_file(string filepath);
+    void write_memory_to_file(string filepath, image_format format = image_format::raw);
     void write_estab_to_file(string filepath);
 
     // getters for priv fields (where's C# {get; private set} ??? im crying)
-    vector<u8> get_memory() const { return memory; }
+    const memory_image &get_memory() const { return memory; }
     u32 get_total_len() const { return total_len; }
-    map<string, u32> get_estab() const { return estab; }
+    u32 get_entry() const { return entry_addr; }
+    map<string, u32> get_estab() const;
+
+    // timings and counters of the last run (phases: pass1, pass2, cache, write)
+    const run_stats &get_stats() const { return stats; }
 
 };
 
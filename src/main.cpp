@@ -3,8 +3,6 @@
 
 #include "cmd/handlers.h"
 
-#define OPCODES_FILE "res/opcodes.txt"
-
 #pragma region commands
 
 using Cmd = ylib::Command;
@@ -21,6 +19,20 @@ vector<Cmd> commands = {
         CmdArg("output", "path to output source file (.asm) [default: out.asm]", "-o", "--output"),
         // symbol table (pass 1 of linker output) to make code readable
         CmdArg("symtab", "path to external symbol table for label resolution", "-s", "--symtab", ylib::ValueType::STRING),
+        // custom instruction set (the built-in SIC/XE table is used otherwise)
+        CmdArg("opcodes", "path to a custom opcode table (format of res/opcodes.txt)", "-t", "--opcodes"),
+        // parallel decoding of one (large) image
+        CmdArg("threads", "decoder threads, 0 = all cores [default: 1]", "-n", "--threads"),
+        // follow the control flow instead of decoding every byte
+        CmdArg("recursive", "recursive traversal from the entry point, unreached bytes become data", "-r", "--recursive", ylib::ValueType::BOOL),
+        // batch mode: a whole corpus in one process
+        CmdArg("batch", "directory of .obj files (or a list file, one path per line) to disassemble", "-b", "--batch"),
+        CmdArg("outdir", "output directory for --batch (<name>.asm + <name>.sym) [default: .]", "-d", "--out-dir"),
+        CmdArg("jobs", "files disassembled at once in --batch, 0 = all cores [default: 0]", "-j", "--jobs"),
+        // no progress bar (it is only drawn on a terminal anyway)
+        CmdArg("quiet", "no progress bar or success message", "-q", "--quiet", ylib::ValueType::BOOL),
+        // phase timings and counters (one json object per file with --stats=json)
+        CmdArg("stats", "print phase timings and counters, --stats=json for JSON", "-S", "--stats", ylib::ValueType::BOOL),
     }, sic::cli::handle_dasm),
 
     // linker
@@ -32,8 +44,30 @@ vector<Cmd> commands = {
         // starting load address
         CmdArg("address", "starting load address [hex] (e.g., 4000)", "-a", "--addr"),
         // export global symbol table
-        CmdArg("export", "export global symbol table to file", "-e", "--export-estab")
+        CmdArg("export", "export global symbol table to file", "-e", "--export-estab"),
+        // parallel parsing/loading of the control sections
+        CmdArg("threads", "linker threads, 0 = all cores [default: 1]", "-n", "--threads"),
+        // incremental relinking
+        CmdArg("cache", "link cache directory (only changed objects are redone)", "-c", "--cache"),
+        // output layout
+        CmdArg("format", "output format: raw, seg (written ranges only) or sparse [default: raw]", "-f", "--format"),
+        // no image in memory + copy, the output file is the image
+        CmdArg("mmap", "build the image directly in the memory-mapped output file (raw format)", "-m", "--mmap", ylib::ValueType::BOOL),
+        // no progress bar (it is only drawn on a terminal anyway)
+        CmdArg("quiet", "no progress bar or success message", "-q", "--quiet", ylib::ValueType::BOOL),
+        // phase timings and counters
+        CmdArg("stats", "print phase timings and counters, --stats=json for JSON", "-S", "--stats", ylib::ValueType::BOOL)
     }, sic::cli::handle_linker),
+
+    // execution engine
+    Cmd("run", "<image> [args...]\tRun a linked SIC/XE memory image (RD reads stdin, WD writes stdout)", {
+        CmdArg("input", "path to the memory image (raw or link --format seg)", "-i", "--input"),
+        // entry point (a seg image carries its own, raw ones start at 0)
+        CmdArg("entry", "entry point [hex] [default: from the image, else 0]", "-e", "--entry"),
+        CmdArg("steps", "stop after this many instructions [default: no limit]", "-s", "--max-steps"),
+        // execution profile
+        CmdArg("hot", "show the N most executed addresses, 0 = no profiling [default: 10]", "-p", "--hot"),
+    }, sic::cli::handle_run),
 };
 
 #pragma endregion
@@ -41,15 +75,8 @@ vector<Cmd> commands = {
 i32 main(i32 argc, char *argv[]) {
     LOG_CHANGE_PRIORITY(LOG_ERROR);
 
-    // load opcodes from the resource file
-    try {
-        op::load_instructions(OPCODES_FILE);
-    }
-    catch (const ylib::Error& e) {
-        LLOG("[", RED_TEXT("ERROR"), "]:\t")
-        LLOG(e.what())
-        return e.errcode();
-    }
+    // NOTE: the opcode table is built at compile time (dasm/opcodes.def),
+    // 'dasm --opcodes <file>' swaps it for a custom one
 
     vector<string> args(argv, argv + argc);
     if(args.size() == 1 || (args.size() == 2 && (args[1] == "-?" || args[1] == "--version")))
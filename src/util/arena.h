@@ -0,0 +1,86 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "../core/defines.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <string.h>
+
+namespace sic {
+
+// bump allocator: hands out pieces of big blocks and frees them all at once.
+// for data that lives exactly as long as its owner (parsed records, names...),
+// so there is no per-object free and no per-object heap header.
+class arena
+{
+public:
+    static constexpr usize BLOCK_SIZE = 64 * 1024;
+
+private:
+    vector<std::unique_ptr<u8[]>> blocks;
+    u8 *next = nullptr;  // free space in the current block
+    usize left = 0;
+    usize total = 0;     // bytes handed out
+
+public:
+    arena() = default;
+    arena(arena &&) = default;
+    arena &operator=(arena &&) = default;
+
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+
+    usize bytes_used() const { return total; }
+
+    void clear() {
+        blocks.clear();
+        next = nullptr;
+        left = 0;
+        total = 0;
+    }
+
+    // n bytes aligned to align (a power of two), never freed on their own
+    void *alloc(usize n, usize align = alignof(std::max_align_t)) {
+        usize pad = (align - ((uintptr_t)next & (align - 1))) & (align - 1);
+
+        if(pad + n > left) {
+            // big requests get a block of their own
+            usize size = std::max(n + align, BLOCK_SIZE);
+            blocks.push_back(std::unique_ptr<u8[]>(new u8[size]));
+
+            next = blocks.back().get();
+            left = size;
+            pad = (align - ((uintptr_t)next & (align - 1))) & (align - 1);
+        }
+
+        void *ptr = next + pad;
+        next += pad + n;
+        left -= pad + n;
+        total += n;
+
+        return ptr;
+    }
+
+    // uninitialized room for n objects of a trivial type
+    template<typename T>
+    T *alloc_array(usize n) {
+        return static_cast<T *>(alloc(n * sizeof(T), alignof(T)));
+    }
+
+    // copy of str that lives as long as the arena
+    std::string_view copy(std::string_view str) {
+        if(str.empty()) return std::string_view();
+
+        char *dst = alloc_array<char>(str.size());
+        memcpy(dst, str.data(), str.size());
+        return std::string_view(dst, str.size());
+    }
+};
+
+} // namespace sic
+
+#endif // ARENA_H
@@ -2,24 +2,47 @@
 #define BASE_H
 
 #include "../core/defines.h"
+#include "../core/error.h"
 #include <algorithm>
+#include <charconv>
+#include <string_view>
 
 // for handling base-n operations
 namespace base {
+    // parses like std::stoi(str, nullptr, 16) (surrounding spaces, a sign and a 0x
+    // prefix are fine) but straight from a view, and nothing may follow the digits
     template<typename T>
-    inline T hextobin(string hexstr) {
-        T val = (T) std::stoi(hexstr, nullptr, 16);
-        return val;
-    }
+    inline T hextobin(std::string_view hexstr) {
+        std::string_view digits = hexstr;
+        while(!digits.empty() && isspace((u8)digits.front())) digits.remove_prefix(1);
+        while(!digits.empty() && isspace((u8)digits.back())) digits.remove_suffix(1);
+
+        bool negative = false;
+        if(!digits.empty() && (digits[0] == '+' || digits[0] == '-')) {
+            negative = digits[0] == '-';
+            digits.remove_prefix(1);
+        }
 
-    inline string bintohex(i32 val, i32 width) {
-        stringstream ss;
+        if(digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+            digits.remove_prefix(2);
+        }
 
-        ss << std::uppercase << std::hex;
-        ss << std::setfill('0') << std::setw(width);
-        ss << val;
+        // unsigned: a second sign is junk, not part of the number
+        u64 val = 0;
+        auto res = std::from_chars(digits.data(), digits.data() + digits.size(), val, 16);
+        if(res.ec != std::errc() || res.ptr != digits.data() + digits.size()) {
+            throw ylib::Error("invalid hex value: '" + string(hexstr) + "'");
+        }
+
+        return negative ? (T)(0 - val) : (T)val;
+    }
 
-        return ss.str();
+    // 64 bit fnv-1a, a fast content hash (not for security)
+    inline u64 fnv1a(std::string_view data, u64 hash = 14695981039346656037ULL) {
+        for(char c : data) {
+            hash = (hash ^ (u8)c) * 1099511628211ULL;
+        }
+        return hash;
     }
 
     inline bool checkbit(i32 val, i32 pos) {
@@ -3,51 +3,146 @@
 #include "../core/defines.h"
 #include "../core/logger.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <thread>
 #include <mutex>
+#include <stdio.h>
 
-#define SLEEP_TIME_MS 5
+#if IPLATFORM_WINDOWS
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#define PROGRESS_REDRAW_MS 100
+#define PROGRESS_STEP 0x10000 // work units a hot loop does between two counter updates
 
 namespace cli {
 
+// these write to stdout directly: whatever the logger still has goes first
+
 inline void init_progress_bar() {
+    Logger::Flush();
     std::cout << "\033[?25l";
 }
 
 inline void reset_terminal() {
-    std::cout << "\033[?25h"; 
+    Logger::Flush();
+    std::cout << "\033[?25h";
     std::cout << std::endl;
 }
 
 inline string cursor = "|/-\\";
 
-inline void draw_progress(i32 start_p, i32 end_p, std::string label, i32 width = 40) {
-    using namespace std::chrono;
-
-    LDEBUG(true, "loading progress bar\n")
-    
-    for (i32 p = start_p; p <= end_p; ++p) {
-        double ratio = p / 100.0;
-        i32 filled = ratio * width;
-
-        // start line + yellow color
-        std::cout << "\r" << "[" << TEXT_YELLOW;
-        
-        // draw filled part
-        for (i32 i = 0; i < filled; ++i) std::cout << "#";
-        std::cout << cursor[p % 4]; 
-
-        // draw empty part
-        for (i32 i = filled; i < width; ++i) std::cout << " ";
-        
-        // reset color, pri32 percentage and label
-        std::cout << TEXT_WHITE << "]" << std::setw(3) 
-                  << p << "% " << label
-                  << std::string(20, ' ') << std::flush;
-
-        // fake delay
-        std::this_thread::sleep_for(milliseconds(SLEEP_TIME_MS));
-    }
+inline bool stdout_is_terminal() {
+#if IPLATFORM_WINDOWS
+    return _isatty(_fileno(stdout));
+#else
+    return isatty(fileno(stdout));
+#endif
 }
 
-} // namespace cli
\ No newline at end of file
+// progress of a running command, driven by real work counters.
+// the work only bumps an atomic (advance), a background thread redraws the bar at most
+// every PROGRESS_REDRAW_MS. nothing is drawn when stdout isn't a terminal, when the
+// owner is quiet, or when the whole run is over before the first redraw.
+class progress {
+private:
+    std::atomic<u64> done{0};
+    std::atomic<u64> total{0};
+    std::atomic<const char *> label{""};
+
+    std::thread renderer;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool drawn = false; // the bar (and the hidden cursor) is on screen
+
+    void draw(i32 frame) {
+        constexpr i32 width = 40;
+
+        u64 all = total.load(std::memory_order_relaxed);
+        u64 now = std::min(done.load(std::memory_order_relaxed), all);
+        i32 percent = all ? (i32)(now * 100 / all) : 0;
+        i32 filled = percent * width / 100;
+
+        if(!drawn) init_progress_bar();
+        else Logger::Flush();
+        drawn = true;
+
+        // one write per frame
+        string bar = "\r[" TEXT_YELLOW;
+        bar.append(filled, '#');
+        bar += cursor[frame % 4];
+        bar.append(width - filled, ' ');
+
+        char tail[16];
+        snprintf(tail, sizeof(tail), "]%3d%% ", percent);
+        bar += TEXT_WHITE;
+        bar += tail;
+        bar += label.load(std::memory_order_relaxed);
+        bar.append(20, ' ');
+
+        std::cout << bar << std::flush;
+    }
+
+    void render() {
+        std::unique_lock<std::mutex> guard(lock);
+
+        for(i32 frame = 0; !stopping; frame++) {
+            wake.wait_for(guard, std::chrono::milliseconds(PROGRESS_REDRAW_MS));
+            if(stopping) break;
+
+            draw(frame);
+        }
+
+        // the final state, then give the terminal back
+        if(drawn) {
+            draw(0);
+            reset_terminal();
+        }
+    }
+
+public:
+    progress() = default;
+    ~progress() { stop(); }
+
+    progress(const progress &) = delete;
+    progress &operator=(const progress &) = delete;
+
+    // starts the renderer (if there is a terminal to draw on)
+    void start(bool quiet = false) {
+        if(quiet || renderer.joinable() || !stdout_is_terminal()) return;
+
+        stopping = false;
+        drawn = false;
+        renderer = std::thread(&progress::render, this);
+    }
+
+    // a new phase: the bar restarts at 0 of total work units
+    void phase(const char *name, u64 units) {
+        done.store(0, std::memory_order_relaxed);
+        total.store(units, std::memory_order_relaxed);
+        label.store(name, std::memory_order_relaxed);
+    }
+
+    // n more units done (any thread)
+    void advance(u64 n = 1) {
+        done.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // waits for the renderer, the terminal is back to normal after this
+    void stop() {
+        if(!renderer.joinable()) return;
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        renderer.join();
+    }
+};
+
+} // namespace cli
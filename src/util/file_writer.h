@@ -0,0 +1,121 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include "../core/defines.h"
+#include "../core/error.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string_view>
+
+namespace sic {
+
+// buffered text writer for listings and tables.
+// rows are formatted straight into one big buffer that goes out in a few large
+// fwrite calls (no iostream, no flush per line).
+class file_writer
+{
+public:
+    static constexpr usize BUFFER_SIZE = 1 << 20;
+
+private:
+    FILE *file = nullptr;
+    string path;
+    bool owned = true; // false for stdout & co, never closed here
+
+    vector<char> buffer;
+    usize used = 0;
+
+public:
+    file_writer(const string &path) : path{path}, buffer(BUFFER_SIZE) {
+        // text mode, same line endings as an ofstream would give
+        file = fopen(path.c_str(), "w");
+        if(!file) {
+            throw ylib::Error("couldn't open output file " + path);
+        }
+
+        // we already buffer, stdio doesn't need to copy it again
+        setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    // writes to an already open stream (e.g. stdout), name is used in error messages
+    file_writer(FILE *stream, const string &name) : file{stream}, path{name}, owned{false}, buffer(BUFFER_SIZE) {}
+
+    ~file_writer() {
+        // errors are reported by close(), this only makes sure the file is released
+        if(file) {
+            fwrite(buffer.data(), 1, used, file);
+            if(owned) fclose(file);
+            else fflush(file);
+        }
+    }
+
+    file_writer(const file_writer &) = delete;
+    file_writer &operator=(const file_writer &) = delete;
+
+    // room for n more chars: write them at the returned pointer, then commit(end)
+    char *claim(usize n) {
+        if(used + n > buffer.size()) {
+            flush();
+            if(n > buffer.size()) buffer.resize(n);
+        }
+
+        return buffer.data() + used;
+    }
+
+    void commit(char *end) { used = end - buffer.data(); }
+
+    void write(std::string_view text) {
+        char *out = claim(text.size());
+        memcpy(out, text.data(), text.size());
+        commit(out + text.size());
+    }
+
+    void put(char c) {
+        if(used == buffer.size()) flush();
+        buffer[used++] = c;
+    }
+
+    // text left aligned in a column of width chars (longer text is kept whole, like setw)
+    void column(std::string_view text, usize width) {
+        usize len = std::max(text.size(), width);
+        char *out = claim(len);
+
+        memcpy(out, text.data(), text.size());
+        memset(out + text.size(), ' ', len - text.size());
+        commit(out + len);
+    }
+
+    void line(std::string_view text) {
+        write(text);
+        put('\n');
+    }
+
+    void flush() {
+        if(used == 0) return;
+
+        if(fwrite(buffer.data(), 1, used, file) != used) {
+            used = 0;
+            throw ylib::Error("couldn't write to " + path);
+        }
+        used = 0;
+    }
+
+    // flushes and closes, throws if any of it failed
+    void close() {
+        if(!file) return;
+
+        flush();
+
+        FILE *f = file;
+        file = nullptr;
+        if(owned ? fclose(f) != 0 : fflush(f) != 0) {
+            throw ylib::Error("couldn't write to " + path);
+        }
+    }
+};
+
+} // namespace sic
+
+#endif // FILE_WRITER_H
@@ -0,0 +1,98 @@
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include "../core/defines.h"
+
+#include <utility>
+
+namespace sic {
+
+// open-addressing hash map for integer keys (addresses, packed names...).
+// one flat array of slots with linear probing, so a lookup is a hash and
+// (almost always) a single cache line. no erase: the tools only ever add.
+template<typename K, typename V>
+class flat_map
+{
+private:
+    struct slot
+    {
+        K key;
+        V value;
+        bool used;
+    };
+
+    vector<slot> slots; // power of two sized (or empty)
+    usize count = 0;
+
+    // fibonacci hashing: spreads sequential keys over the whole table
+    usize index_of(K key) const {
+        u64 h = (u64)key * 0x9E3779B97F4A7C15ULL;
+        return (usize)(h >> 32) & (slots.size() - 1);
+    }
+
+    void grow() {
+        vector<slot> old = std::move(slots);
+        slots.assign(old.empty() ? 16 : old.size() * 2, slot{});
+        count = 0;
+
+        for(slot &s : old) {
+            if(s.used) insert(s.key, std::move(s.value));
+        }
+    }
+
+public:
+    usize size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void clear() {
+        slots.clear();
+        count = 0;
+    }
+
+    // room for n keys without rehashing
+    void reserve(usize n) {
+        while(slots.size() * 3 < n * 4) grow();
+    }
+
+    V *find(K key) {
+        if(slots.empty()) return nullptr;
+
+        for(usize i = index_of(key);; i = (i + 1) & (slots.size() - 1)) {
+            if(!slots[i].used) return nullptr;
+            if(slots[i].key == key) return &slots[i].value;
+        }
+    }
+
+    const V *find(K key) const { return const_cast<flat_map *>(this)->find(key); }
+
+    // inserts key -> value unless the key is already there.
+    // returns the stored value and whether it was inserted
+    std::pair<V *, bool> insert(K key, V value) {
+        // keep the load factor under 3/4
+        if((count + 1) * 4 > slots.size() * 3) grow();
+
+        for(usize i = index_of(key);; i = (i + 1) & (slots.size() - 1)) {
+            slot &s = slots[i];
+
+            if(!s.used) {
+                s = slot{key, std::move(value), true};
+                count++;
+                return {&s.value, true};
+            }
+
+            if(s.key == key) return {&s.value, false};
+        }
+    }
+
+    // fn(key, value) for every entry, in table (not key) order
+    template<typename F>
+    void for_each(F fn) const {
+        for(const slot &s : slots) {
+            if(s.used) fn(s.key, s.value);
+        }
+    }
+};
+
+} // namespace sic
+
+#endif // FLAT_MAP_H
@@ -0,0 +1,254 @@
+#include "hex.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define HEX_SIMD_X86 1
+    #include <immintrin.h>
+#endif
+
+namespace {
+
+// ascii -> nibble, 0xFF for anything that isn't a hex digit
+constexpr std::array<u8, 256> make_nibble_table() {
+    std::array<u8, 256> table{};
+
+    for(i32 c = 0; c < 256; c++) {
+        if(c >= '0' && c <= '9') table[c] = c - '0';
+        else if(c >= 'A' && c <= 'F') table[c] = c - 'A' + 10;
+        else if(c >= 'a' && c <= 'f') table[c] = c - 'a' + 10;
+        else table[c] = 0xFF;
+    }
+
+    return table;
+}
+
+constexpr std::array<u8, 256> nibble_table = make_nibble_table();
+
+// byte -> its two uppercase digits
+constexpr std::array<char, 512> make_digit_pairs() {
+    const char *digits = "0123456789ABCDEF";
+    std::array<char, 512> table{};
+
+    for(i32 b = 0; b < 256; b++) {
+        table[2 * b] = digits[b >> 4];
+        table[2 * b + 1] = digits[b & 0xF];
+    }
+
+    return table;
+}
+
+constexpr std::array<char, 512> digit_pairs = make_digit_pairs();
+
+// scalar path: one table lookup per digit.
+// handles bytes [start, n) and returns the number of valid ones
+usize decode_scalar(const char *src, usize start, usize n, u8 *dst, u64 *mask) {
+    usize valid = 0;
+
+    for(usize i = start; i < n; i++) {
+        u8 high = nibble_table[(u8)src[2 * i]];
+        u8 low = nibble_table[(u8)src[2 * i + 1]];
+
+        if((high | low) & 0xF0) {
+            dst[i] = 0;
+            continue;
+        }
+
+        dst[i] = (high << 4) | low;
+        valid++;
+
+        if(mask) mask[i >> 6] |= (u64)1 << (i & 63);
+    }
+
+    return valid;
+}
+
+#if HEX_SIMD_X86
+
+// sse2 is part of x86-64, so this path needs no dispatch.
+// every digit is mapped to its nibble value + a validity lane, then the
+// (high, low) byte pairs are folded into one byte per 16-bit lane.
+inline __m128i nibbles_sse2(__m128i chars, __m128i &valid) {
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+    const __m128i zero = _mm_setzero_si128();
+
+    // '0'..'9'
+    __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_subs_epu8(digit, nine), zero);
+
+    // 'A'..'F' / 'a'..'f' (folding to lower case)
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_subs_epu8(alpha, five), zero);
+
+    valid = _mm_or_si128(is_digit, is_alpha);
+
+    alpha = _mm_add_epi8(alpha, _mm_set1_epi8(10));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit), _mm_and_si128(is_alpha, alpha));
+}
+
+// 32 digits -> 16 bytes, returns the 16-bit validity mask
+inline u32 decode16_sse2(const char *src, u8 *dst) {
+    __m128i valid0, valid1;
+    __m128i n0 = nibbles_sse2(_mm_loadu_si128((const __m128i *)src), valid0);
+    __m128i n1 = nibbles_sse2(_mm_loadu_si128((const __m128i *)(src + 16)), valid1);
+
+    // lane = high | (low << 8) -> (high << 4) | low
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    __m128i b0 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n0, low_byte), 4), _mm_srli_epi16(n0, 8));
+    __m128i b1 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n1, low_byte), 4), _mm_srli_epi16(n1, 8));
+
+    // a byte is valid only when both of its digits are
+    const __m128i ones = _mm_set1_epi16(-1);
+    __m128i pair_valid = _mm_packs_epi16(_mm_cmpeq_epi16(valid0, ones), _mm_cmpeq_epi16(valid1, ones));
+
+    __m128i bytes = _mm_and_si128(_mm_packus_epi16(b0, b1), pair_valid);
+    _mm_storeu_si128((__m128i *)dst, bytes);
+
+    return (u32)_mm_movemask_epi8(pair_valid);
+}
+
+// 16 bytes -> 32 digits: split into nibbles, interleave, then map 0..15 to ascii
+inline void encode16_sse2(const u8 *src, char *dst) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)src);
+
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble);
+    __m128i low = _mm_and_si128(bytes, low_nibble);
+
+    __m128i first = _mm_unpacklo_epi8(high, low);
+    __m128i second = _mm_unpackhi_epi8(high, low);
+
+    // '0' + v, plus 7 more to jump from '9' to 'A'
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i alpha_gap = _mm_set1_epi8('A' - '0' - 10);
+
+    first = _mm_add_epi8(_mm_add_epi8(first, ascii_zero), _mm_and_si128(_mm_cmpgt_epi8(first, nine), alpha_gap));
+    second = _mm_add_epi8(_mm_add_epi8(second, ascii_zero), _mm_and_si128(_mm_cmpgt_epi8(second, nine), alpha_gap));
+
+    _mm_storeu_si128((__m128i *)dst, first);
+    _mm_storeu_si128((__m128i *)(dst + 16), second);
+}
+
+// decodes 16-byte blocks from byte i (a multiple of 16) on, leaves i after the last block
+usize decode_sse2(const char *src, usize &i, usize n, u8 *dst, u64 *mask) {
+    usize valid = 0;
+
+    for(; i + 16 <= n; i += 16) {
+        u32 bits = decode16_sse2(src + 2 * i, dst + i);
+        valid += __builtin_popcount(bits);
+
+        // i is a multiple of 16, so the 16 bits never straddle two mask words
+        if(mask) mask[i >> 6] |= (u64)bits << (i & 63);
+    }
+
+    return valid;
+}
+
+    #if defined(__GNUC__) || defined(__clang__)
+        #define HEX_HAS_AVX2 1
+
+__attribute__((target("avx2"))) inline __m256i nibbles_avx2(__m256i chars, __m256i &valid) {
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i five = _mm256_set1_epi8(5);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_subs_epu8(digit, nine), zero);
+
+    __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_subs_epu8(alpha, five), zero);
+
+    valid = _mm256_or_si256(is_digit, is_alpha);
+
+    alpha = _mm256_add_epi8(alpha, _mm256_set1_epi8(10));
+    return _mm256_or_si256(_mm256_and_si256(is_digit, digit), _mm256_and_si256(is_alpha, alpha));
+}
+
+// 64 digits -> 32 bytes, returns the 32-bit validity mask
+__attribute__((target("avx2"))) inline u32 decode32_avx2(const char *src, u8 *dst) {
+    __m256i valid0, valid1;
+    __m256i n0 = nibbles_avx2(_mm256_loadu_si256((const __m256i *)src), valid0);
+    __m256i n1 = nibbles_avx2(_mm256_loadu_si256((const __m256i *)(src + 32)), valid1);
+
+    // (high * 16) + low in every 16-bit lane
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    __m256i b0 = _mm256_maddubs_epi16(n0, weights);
+    __m256i b1 = _mm256_maddubs_epi16(n1, weights);
+
+    const __m256i ones = _mm256_set1_epi16(-1);
+    __m256i pair_valid = _mm256_packs_epi16(_mm256_cmpeq_epi16(valid0, ones), _mm256_cmpeq_epi16(valid1, ones));
+    __m256i bytes = _mm256_packus_epi16(b0, b1);
+
+    // the packs work per 128-bit lane, put the qwords back in order
+    pair_valid = _mm256_permute4x64_epi64(pair_valid, 0xD8);
+    bytes = _mm256_and_si256(_mm256_permute4x64_epi64(bytes, 0xD8), pair_valid);
+
+    _mm256_storeu_si256((__m256i *)dst, bytes);
+
+    return (u32)_mm256_movemask_epi8(pair_valid);
+}
+
+// same as decode_sse2 with 32-byte blocks
+__attribute__((target("avx2"))) usize decode_avx2(const char *src, usize &i, usize n, u8 *dst, u64 *mask) {
+    usize valid = 0;
+
+    for(; i + 32 <= n; i += 32) {
+        u32 bits = decode32_avx2(src + 2 * i, dst + i);
+        valid += __builtin_popcount(bits);
+
+        if(mask) mask[i >> 6] |= (u64)bits << (i & 63);
+    }
+
+    return valid;
+}
+
+bool cpu_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+    #endif
+
+#endif // HEX_SIMD_X86
+
+} // namespace
+
+usize base::decode_hex(const char *src, usize n, u8 *dst, u64 *mask) {
+    if(mask) {
+        for(usize w = 0; w < (n + 63) / 64; w++) mask[w] = 0;
+    }
+
+    usize valid = 0;
+    usize done = 0;
+
+#if HEX_SIMD_X86
+    #if HEX_HAS_AVX2
+    if(cpu_has_avx2()) {
+        valid += decode_avx2(src, done, n, dst, mask);
+    }
+    #endif
+
+    // leftovers of the avx2 loop (or everything without avx2)
+    valid += decode_sse2(src, done, n, dst, mask);
+#endif
+
+    return valid + decode_scalar(src, done, n, dst, mask);
+}
+
+char *base::format_hex_bytes(char *out, const u8 *bytes, usize n) {
+    usize i = 0;
+
+#if HEX_SIMD_X86
+    for(; i + 16 <= n; i += 16) {
+        encode16_sse2(bytes + i, out + 2 * i);
+    }
+#endif
+
+    for(; i < n; i++) {
+        out[2 * i] = digit_pairs[2 * bytes[i]];
+        out[2 * i + 1] = digit_pairs[2 * bytes[i] + 1];
+    }
+
+    return out + 2 * n;
+}
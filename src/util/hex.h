@@ -0,0 +1,40 @@
+#ifndef HEX_H
+#define HEX_H
+
+#include "../core/defines.h"
+
+// bulk hex <-> binary kernels (for T record payloads and listings)
+namespace base {
+
+// decodes n bytes from the 2 * n hex digits at src into dst.
+// never throws: bit i of mask (mask[i / 64] >> (i % 64)) is set when byte i was made
+// of two valid hex digits, invalid bytes are written as 0. mask may be nullptr,
+// otherwise it must hold (n + 63) / 64 words.
+// returns the number of valid bytes (== n when the whole payload is clean)
+usize decode_hex(const char *src, usize n, u8 *dst, u64 *mask);
+
+// writes val as uppercase hex, zero padded to at least width digits (wider values
+// keep all their digits, like setw). out must have room for max(width, 8) chars.
+// returns the end of the written digits, nothing is null terminated
+inline char *format_hex(char *out, u32 val, i32 width) {
+    const char *digits = "0123456789ABCDEF";
+
+    i32 len = 1;
+    for(u32 v = val >> 4; v; v >>= 4) len++;
+    if(len < width) len = width;
+
+    for(i32 i = len - 1; i >= 0; i--) {
+        out[i] = digits[val & 0xF];
+        val >>= 4;
+    }
+
+    return out + len;
+}
+
+// writes the 2 * n uppercase hex digits of bytes into out (vectorized for long spans).
+// returns the end of the written digits
+char *format_hex_bytes(char *out, const u8 *bytes, usize n);
+
+} // namespace base
+
+#endif // HEX_H
@@ -0,0 +1,108 @@
+#ifndef INTERVAL_SET_H
+#define INTERVAL_SET_H
+
+#include "../core/defines.h"
+
+#include <algorithm>
+
+namespace sic {
+
+// half-open address range [start, end)
+struct interval
+{
+    u32 start;
+    u32 end;
+
+    u32 size() const { return end - start; }
+};
+
+// sorted set of disjoint, non-touching address ranges.
+// used as the coverage map of a loaded image: the runs are the bytes some T record
+// wrote, everything between two runs is a hole (RESW/RESB).
+class interval_set
+{
+private:
+    vector<interval> runs; // sorted by start, merged (never overlapping or adjacent)
+
+public:
+    void clear() { runs.clear(); }
+    bool empty() const { return runs.empty(); }
+    usize size() const { return runs.size(); }
+
+    const interval &operator[](usize i) const { return runs[i]; }
+    vector<interval>::const_iterator begin() const { return runs.begin(); }
+    vector<interval>::const_iterator end() const { return runs.end(); }
+
+    // total number of covered addresses
+    u64 covered() const {
+        u64 total = 0;
+        for(const interval &run : runs) total += run.size();
+        return total;
+    }
+
+    // index of the first run that ends after addr (size() if none).
+    // addr is covered if that run also starts at or before it
+    usize find(u32 addr) const {
+        auto it = std::upper_bound(runs.begin(), runs.end(), addr,
+                                   [](u32 a, const interval &run) { return a < run.end; });
+        return it - runs.begin();
+    }
+
+    bool contains(u32 addr) const {
+        usize i = find(addr);
+        return i < runs.size() && runs[i].start <= addr;
+    }
+
+    void add(u32 start, u32 end) {
+        if(start >= end) return;
+
+        // object files list T records in ascending order, so appending
+        // (or growing the last run) is the common case
+        if(runs.empty() || start > runs.back().end) {
+            runs.push_back({start, end});
+            return;
+        }
+
+        if(start >= runs.back().start) {
+            runs.back().end = std::max(runs.back().end, end);
+            return;
+        }
+
+        // general case: merge with every run it touches
+        auto first = std::lower_bound(runs.begin(), runs.end(), start,
+                                      [](const interval &run, u32 a) { return run.end < a; });
+        auto last = first;
+
+        while(last != runs.end() && last->start <= end) {
+            start = std::min(start, last->start);
+            end = std::max(end, last->end);
+            last++;
+        }
+
+        first = runs.erase(first, last);
+        runs.insert(first, {start, end});
+    }
+
+    // forgets every run that ends at or before addr
+    void drop_before(u32 addr) {
+        runs.erase(runs.begin(), runs.begin() + find(addr));
+    }
+
+    // adds addr + i for every bit i set in mask (see base::decode_hex), run by run
+    void add(u32 addr, usize n, const u64 *mask) {
+        usize i = 0;
+        while(i < n) {
+            // skip clear bits, then take the run of set bits
+            while(i < n && !((mask[i >> 6] >> (i & 63)) & 1)) i++;
+
+            usize run_start = i;
+            while(i < n && ((mask[i >> 6] >> (i & 63)) & 1)) i++;
+
+            if(i > run_start) add(addr + run_start, addr + i);
+        }
+    }
+};
+
+} // namespace sic
+
+#endif // INTERVAL_SET_H
@@ -0,0 +1,115 @@
+#ifndef MAPPED_OUTPUT_H
+#define MAPPED_OUTPUT_H
+
+#include "../core/defines.h"
+#include "../core/error.h"
+
+#if IPLATFORM_WINDOWS
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace sic {
+
+// writable memory mapping of an output file of a known size (the write side of
+// mapped_file). the file is created (or truncated) at that size, whatever is
+// written to bytes() ends up in it, no write calls and no copy in between.
+class mapped_output
+{
+private:
+    u8 *data = nullptr;
+    usize size = 0;
+    string path;
+
+#if IPLATFORM_WINDOWS
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE map_handle = nullptr;
+#endif
+
+public:
+    mapped_output(const string &filepath, usize length) : size{length}, path{filepath} {
+#if IPLATFORM_WINDOWS
+        file_handle = CreateFileA(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                  CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file_handle == INVALID_HANDLE_VALUE) {
+            throw ylib::Error("couldn't open output file " + filepath);
+        }
+
+        // nothing to map in an empty file
+        if(size == 0) return;
+
+        LARGE_INTEGER file_size;
+        file_size.QuadPart = (LONGLONG)size;
+        map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READWRITE,
+                                        file_size.HighPart, file_size.LowPart, nullptr);
+        if(map_handle != nullptr) {
+            data = (u8 *)MapViewOfFile(map_handle, FILE_MAP_WRITE, 0, 0, 0);
+        }
+#else
+        i32 fd = open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) {
+            throw ylib::Error("couldn't open output file " + filepath);
+        }
+
+        if(size == 0) {
+            close(fd);
+            return;
+        }
+
+        // blocks are taken now: a full disk is an error here, not a SIGBUS on some later write
+#if IPLATFORM_LINUX
+        bool sized = posix_fallocate(fd, 0, (off_t)size) == 0;
+#else
+        bool sized = ftruncate(fd, (off_t)size) == 0;
+#endif
+        if(!sized) {
+            close(fd);
+            throw ylib::Error("couldn't resize output file " + filepath);
+        }
+
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd); // the mapping keeps its own reference
+
+        if(ptr != MAP_FAILED) data = (u8 *)ptr;
+#endif
+
+        if(data == nullptr) {
+            release();
+            throw ylib::Error("couldn't map output file " + filepath);
+        }
+    }
+
+    ~mapped_output() { release(); }
+
+    mapped_output(const mapped_output &) = delete;
+    mapped_output &operator=(const mapped_output &) = delete;
+
+    // size bytes, writable up to the end of the last (os) page
+    u8 *bytes() { return data; }
+    const u8 *bytes() const { return data; }
+    usize length() const { return size; }
+    const string &filepath() const { return path; }
+
+private:
+    void release() {
+#if IPLATFORM_WINDOWS
+        if(data) UnmapViewOfFile(data);
+        if(map_handle) CloseHandle(map_handle);
+        if(file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+        map_handle = nullptr;
+        file_handle = INVALID_HANDLE_VALUE;
+#else
+        if(data) munmap(data, size);
+#endif
+        data = nullptr;
+    }
+};
+
+} // namespace sic
+
+#endif // MAPPED_OUTPUT_H
@@ -0,0 +1,334 @@
+#ifndef MEMORY_IMAGE_H
+#define MEMORY_IMAGE_H
+
+#include "../core/defines.h"
+
+#include <algorithm>
+#include <memory>
+#include <string.h>
+
+namespace sic {
+
+// sparse byte-addressed memory shared by the disassembler and the linker.
+// the address space is split in 4 KB pages that only exist once something is
+// written to them, so a small program loaded high costs a couple of pages
+// instead of everything below it. each page keeps a bitmap of the bytes that
+// were actually written (code/data vs RESW/RESB holes).
+class memory_image
+{
+public:
+    static constexpr u32 PAGE_BITS = 12;
+    static constexpr u32 PAGE_SIZE = 1 << PAGE_BITS;
+    static constexpr u32 PAGE_MASK = PAGE_SIZE - 1;
+
+    struct page
+    {
+        u8 *data;                       // PAGE_SIZE bytes: storage, or a piece of the attached buffer
+        u64 init[PAGE_SIZE / 64];       // bit set = byte was written
+        std::unique_ptr<u8[]> storage;  // null for attached pages
+    };
+
+private:
+    vector<std::unique_ptr<page>> pages; // page directory, indexed by addr >> PAGE_BITS
+    u8 fill;                             // value read back from bytes nobody wrote
+    usize allocated = 0;                 // number of live pages
+    usize released = 0;                  // pages below this index were released
+
+    u8 *attached = nullptr;              // caller's buffer holding addresses [0, attached_pages * PAGE_SIZE)
+    usize attached_pages = 0;
+
+public:
+    memory_image(u8 fill = 0) : fill{fill} {}
+
+    void clear() {
+        pages.clear();
+        allocated = 0;
+        released = 0;
+        attached = nullptr;
+        attached_pages = 0;
+    }
+
+    // makes buffer (not owned, e.g. a mapped output file) the storage of addresses
+    // [0, size): pages there are never allocated, writes land straight in it.
+    // buffer must be writable up to the next page boundary after size.
+    // only on an empty image (after clear()), the whole buffer gets the fill value
+    void attach(u8 *buffer, usize size) {
+        attached = buffer;
+        attached_pages = (size + PAGE_SIZE - 1) >> PAGE_BITS;
+        memset(buffer, fill, attached_pages * PAGE_SIZE);
+    }
+
+    usize page_count() const { return allocated; }
+    u8 fill_value() const { return fill; }
+
+    // --- single bytes ---
+
+    u8 read(u32 addr) const {
+        const page *pg = find(addr);
+        return pg ? pg->data[addr & PAGE_MASK] : fill;
+    }
+
+    bool is_initialized(u32 addr) const {
+        const page *pg = find(addr);
+        if(!pg) return false;
+
+        u32 off = addr & PAGE_MASK;
+        return (pg->init[off >> 6] >> (off & 63)) & 1;
+    }
+
+    void write(u32 addr, u8 val) {
+        page &pg = get(addr);
+        u32 off = addr & PAGE_MASK;
+
+        pg.data[off] = val;
+        pg.init[off >> 6] |= (u64)1 << (off & 63);
+    }
+
+    // --- spans ---
+
+    // copies [addr, addr + n) into dst, missing pages read as the fill value
+    void read(u32 addr, u8 *dst, usize n) const {
+        while(n > 0) {
+            u32 off = addr & PAGE_MASK;
+            usize chunk = std::min<usize>(n, PAGE_SIZE - off);
+
+            const page *pg = find(addr);
+            if(pg) memcpy(dst, pg->data + off, chunk);
+            else memset(dst, fill, chunk);
+
+            addr += chunk;
+            dst += chunk;
+            n -= chunk;
+        }
+    }
+
+    // copies src into [addr, addr + n) and marks it initialized
+    void write(u32 addr, const u8 *src, usize n) {
+        while(n > 0) {
+            u32 off = addr & PAGE_MASK;
+            usize chunk = std::min<usize>(n, PAGE_SIZE - off);
+
+            memcpy(get(addr).data + off, src, chunk);
+            mark(addr, chunk);
+
+            addr += chunk;
+            src += chunk;
+            n -= chunk;
+        }
+    }
+
+    // copies only the bytes of src set in mask into [addr, addr + n) and marks them,
+    // the others keep whatever they had (see base::decode_hex)
+    void write(u32 addr, const u8 *src, usize n, const u64 *mask) {
+        for(usize w = 0; w < (n + 63) / 64; w++) {
+            u64 bits = mask[w];
+            if(w * 64 + 64 > n) bits &= ((u64)1 << (n - w * 64)) - 1;
+
+            while(bits) {
+                u32 i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                write(addr + i, src[i]);
+            }
+        }
+    }
+
+    // writable pointer to addr, avail = bytes left until the end of its page.
+    // the bytes are not marked initialized, call mark() once they are filled
+    u8 *span(u32 addr, usize &avail) {
+        u32 off = addr & PAGE_MASK;
+        avail = PAGE_SIZE - off;
+        return get(addr).data + off;
+    }
+
+    // read-only pointer to addr (nullptr if its page was never written)
+    const u8 *span(u32 addr, usize &avail) const {
+        u32 off = addr & PAGE_MASK;
+        avail = PAGE_SIZE - off;
+
+        const page *pg = find(addr);
+        return pg ? pg->data + off : nullptr;
+    }
+
+    // allocates the pages of [addr, addr + n) up front. once every page a set of
+    // threads touches exists, poke() on disjoint ranges is safe from all of them
+    void reserve(u32 addr, usize n) {
+        if(n == 0) return;
+
+        for(u64 idx = addr >> PAGE_BITS; idx <= ((u64)addr + n - 1) >> PAGE_BITS; idx++) {
+            get((u32)(idx << PAGE_BITS));
+        }
+    }
+
+    // copies src into [addr, addr + n) of reserved pages: no allocation and no
+    // init bits (those share words across ranges), mark() the range afterwards
+    void poke(u32 addr, const u8 *src, usize n) {
+        while(n > 0) {
+            u32 off = addr & PAGE_MASK;
+            usize chunk = std::min<usize>(n, PAGE_SIZE - off);
+
+            memcpy(pages[addr >> PAGE_BITS]->data + off, src, chunk);
+
+            addr += chunk;
+            src += chunk;
+            n -= chunk;
+        }
+    }
+
+    // fn(run_start, run_end) for every run of initialized bytes in [start, end), in order
+    template<typename F>
+    void for_each_run(u32 start, u32 end, F fn) const {
+        u64 addr = start;
+        u64 run_start = 0;
+        bool in_run = false;
+
+        while(addr < end) {
+            const page *pg = find((u32)addr);
+            u64 page_end = std::min<u64>(end, (addr | PAGE_MASK) + 1);
+
+            if(!pg) {
+                if(in_run) fn((u32)run_start, (u32)addr);
+                in_run = false;
+                addr = page_end;
+                continue;
+            }
+
+            while(addr < page_end) {
+                u32 off = addr & PAGE_MASK;
+                u64 word = pg->init[off >> 6];
+
+                // whole words at once when they are all set or all clear
+                if((off & 63) == 0 && addr + 64 <= page_end && (word == 0 || word == ~0ULL)) {
+                    if((word != 0) != in_run) {
+                        if(in_run) fn((u32)run_start, (u32)addr);
+                        else run_start = addr;
+                        in_run = !in_run;
+                    }
+                    addr += 64;
+                    continue;
+                }
+
+                bool set = (word >> (off & 63)) & 1;
+                if(set != in_run) {
+                    if(in_run) fn((u32)run_start, (u32)addr);
+                    else run_start = addr;
+                    in_run = set;
+                }
+                addr++;
+            }
+        }
+
+        if(in_run) fn((u32)run_start, end);
+    }
+
+    // forgets what was written to [addr, addr + n): back to the fill value, not initialized
+    void reset(u32 addr, usize n) {
+        while(n > 0) {
+            u32 off = addr & PAGE_MASK;
+            usize chunk = std::min<usize>(n, PAGE_SIZE - off);
+
+            usize idx = addr >> PAGE_BITS;
+            if(idx < pages.size() && pages[idx]) {
+                page &pg = *pages[idx];
+                memset(pg.data + off, fill, chunk);
+
+                for(u32 bit = off; bit < off + chunk; bit++) {
+                    pg.init[bit >> 6] &= ~((u64)1 << (bit & 63));
+                }
+            }
+
+            addr += chunk;
+            n -= chunk;
+        }
+    }
+
+    // marks [addr, addr + n) initialized
+    void mark(u32 addr, usize n) {
+        while(n > 0) {
+            u32 off = addr & PAGE_MASK;
+            usize chunk = std::min<usize>(n, PAGE_SIZE - off);
+            u64 *init = get(addr).init;
+
+            // whole words where possible, partial masks at both ends
+            for(u32 bit = off; bit < off + chunk;) {
+                u32 word = bit >> 6;
+                u32 first = bit & 63;
+                u32 count = std::min<u32>(64 - first, off + chunk - bit);
+
+                u64 bits = count == 64 ? ~0ULL : (((u64)1 << count) - 1) << first;
+                init[word] |= bits;
+                bit += count;
+            }
+
+            addr += chunk;
+            n -= chunk;
+        }
+    }
+
+    // marks byte addr + i initialized for every bit i set in mask (see base::decode_hex)
+    void mark(u32 addr, usize n, const u64 *mask) {
+        for(usize w = 0; w < (n + 63) / 64; w++) {
+            u64 bits = mask[w];
+            if(w * 64 + 64 > n) bits &= ((u64)1 << (n - w * 64)) - 1;
+
+            while(bits) {
+                u32 i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                u32 a = addr + i;
+                u32 off = a & PAGE_MASK;
+                get(a).init[off >> 6] |= (u64)1 << (off & 63);
+            }
+        }
+    }
+
+    // frees every page that lies entirely below addr (streaming: that part is done).
+    // reading there gives the fill value again
+    void release_below(u32 addr) {
+        usize last = std::min<usize>(addr >> PAGE_BITS, pages.size());
+
+        for(usize idx = released; idx < last; idx++) {
+            if(pages[idx]) {
+                pages[idx].reset();
+                allocated--;
+            }
+        }
+
+        released = std::max(released, last);
+    }
+
+private:
+    const page *find(u32 addr) const {
+        usize idx = addr >> PAGE_BITS;
+        return idx < pages.size() ? pages[idx].get() : nullptr;
+    }
+
+    // page holding addr, allocated (and filled) on first use
+    page &get(u32 addr) {
+        usize idx = addr >> PAGE_BITS;
+        if(idx >= pages.size()) pages.resize(idx + 1);
+
+        if(!pages[idx]) {
+            auto pg = std::make_unique<page>();
+
+            if(idx < attached_pages) {
+                // already holds the fill (see attach)
+                pg->data = attached + (idx << PAGE_BITS);
+            }
+            else {
+                pg->storage = std::unique_ptr<u8[]>(new u8[PAGE_SIZE]); // no value-init, filled below
+                pg->data = pg->storage.get();
+                memset(pg->data, fill, PAGE_SIZE);
+            }
+
+            pages[idx] = std::move(pg);
+            allocated++;
+        }
+
+        return *pages[idx];
+    }
+};
+
+} // namespace sic
+
+#endif // MEMORY_IMAGE_H
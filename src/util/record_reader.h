@@ -0,0 +1,332 @@
+#ifndef RECORD_READER_H
+#define RECORD_READER_H
+
+#include "../core/defines.h"
+#include "../core/error.h"
+
+#include "hex.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string_view>
+#include <string.h>
+
+#if IPLATFORM_WINDOWS
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace sic {
+
+// read-only memory mapping of a whole file.
+// the mapping lives as long as the object, every view handed out points into it.
+class mapped_file
+{
+private:
+    const char *data = nullptr;
+    usize size = 0;
+
+#if IPLATFORM_WINDOWS
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE map_handle = nullptr;
+#endif
+
+public:
+    mapped_file(const string &filepath) {
+#if IPLATFORM_WINDOWS
+        file_handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file_handle == INVALID_HANDLE_VALUE) {
+            throw ylib::Error("couldn't open file at " + filepath);
+        }
+
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file_handle, &file_size);
+        size = (usize)file_size.QuadPart;
+
+        // windows refuses to map empty files
+        if(size == 0) return;
+
+        map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(map_handle != nullptr) {
+            data = (const char *)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+        }
+#else
+        i32 fd = open(filepath.c_str(), O_RDONLY);
+        if(fd < 0) {
+            throw ylib::Error("couldn't open file at " + filepath);
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0) {
+            close(fd);
+            throw ylib::Error("couldn't stat file at " + filepath);
+        }
+        size = (usize)st.st_size;
+
+        // mmap refuses zero-length mappings
+        if(size == 0) {
+            close(fd);
+            return;
+        }
+
+        void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping keeps its own reference
+
+        if(ptr != MAP_FAILED) {
+            data = (const char *)ptr;
+            madvise(ptr, size, MADV_SEQUENTIAL);
+        }
+#endif
+
+        if(data == nullptr) {
+            release();
+            throw ylib::Error("couldn't map file at " + filepath);
+        }
+    }
+
+    ~mapped_file() { release(); }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    std::string_view view() const { return std::string_view(data, data ? size : 0); }
+
+private:
+    void release() {
+#if IPLATFORM_WINDOWS
+        if(data) UnmapViewOfFile(data);
+        if(map_handle) CloseHandle(map_handle);
+        if(file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+        map_handle = nullptr;
+        file_handle = INVALID_HANDLE_VALUE;
+#else
+        if(data) munmap((void *)data, size);
+#endif
+        data = nullptr;
+    }
+};
+
+// strip spaces/tabs from both ends without copying
+inline std::string_view trim_view(std::string_view str) {
+    const char *whitespace = " \t\r\n";
+    usize first = str.find_first_not_of(whitespace);
+
+    if(first == std::string_view::npos) return std::string_view();
+
+    usize last = str.find_last_not_of(whitespace);
+    return str.substr(first, last - first + 1);
+}
+
+// one H/D/R/T/M/E line of an object file.
+// object files may separate fields with '^' (and end lines with "\r\n"), so every
+// offset here is "logical": it counts characters as if the separators were removed,
+// which keeps the field layout from the textbook (e.g. T: addr @1, len @7, code @9).
+struct record
+{
+    std::string_view raw; // the line as stored in the file (no '\n')
+    bool plain = true;    // true = no separators in the line, logical == physical
+
+    static bool is_separator(char c) { return c == '^' || c == '\r'; }
+
+    char type() const { return plain ? raw[0] : raw[physical(0)]; }
+
+    // logical length of the record
+    usize length() const {
+        if(plain) return raw.size();
+
+        usize len = 0;
+        for(char c : raw) {
+            if(!is_separator(c)) len++;
+        }
+        return len;
+    }
+
+    // view of [off, off + len) in logical offsets.
+    // a field never spans a separator, so the view stops early at one.
+    std::string_view field(usize off, usize len = std::string_view::npos) const {
+        if(plain) {
+            if(off >= raw.size()) return std::string_view();
+            return raw.substr(off, len);
+        }
+
+        usize start = physical(off);
+        usize end = start;
+        while(end < raw.size() && (end - start) < len && !is_separator(raw[end])) {
+            end++;
+        }
+
+        return raw.substr(start, end - start);
+    }
+
+    // calls fn(std::string_view) for every separator-free run starting at logical off
+    template<typename F>
+    void for_each_chunk(usize off, F fn) const {
+        if(plain) {
+            if(off < raw.size()) fn(raw.substr(off));
+            return;
+        }
+
+        usize pos = physical(off);
+        while(pos < raw.size()) {
+            usize end = pos;
+            while(end < raw.size() && !is_separator(raw[end])) end++;
+
+            if(end > pos) fn(raw.substr(pos, end - pos));
+
+            pos = end + 1;
+        }
+    }
+
+    // decodes up to max_bytes bytes of hex payload from logical off straight into dst
+    // (see base::decode_hex for mask, valid gets the number of clean bytes).
+    // returns the number of bytes present in the record, which is less than
+    // max_bytes when the payload is cut short.
+    usize decode_hex(usize off, usize max_bytes, u8 *dst, u64 *mask, usize *valid = nullptr) const {
+        if(plain) {
+            usize avail = off < raw.size() ? (raw.size() - off) / 2 : 0;
+            usize n = std::min(avail, max_bytes);
+
+            usize clean = base::decode_hex(raw.data() + off, n, dst, mask);
+            if(valid) *valid = clean;
+            return n;
+        }
+
+        // separators inside the payload: gather the digits first.
+        // T records hold at most 0xFF bytes so this stays on the stack
+        char digits[2 * 0xFF];
+        usize count = 0;
+        usize limit = std::min(max_bytes, (usize)0xFF) * 2;
+
+        for_each_chunk(off, [&](std::string_view chunk) {
+            usize take = std::min(chunk.size(), limit - count);
+            memcpy(digits + count, chunk.data(), take);
+            count += take;
+        });
+
+        usize n = count / 2;
+        usize clean = base::decode_hex(digits, n, dst, mask);
+        if(valid) *valid = clean;
+        return n;
+    }
+
+private:
+    // physical index of logical offset off (raw.size() if past the end)
+    usize physical(usize off) const {
+        usize pos = 0;
+        for(; pos < raw.size(); pos++) {
+            if(is_separator(raw[pos])) continue;
+            if(off == 0) break;
+            off--;
+        }
+        return pos;
+    }
+};
+
+// walks an object file buffer line by line, yielding records that point into it.
+// nothing is copied: the buffer (usually a mapped_file) must outlive the records.
+class record_reader
+{
+private:
+    std::string_view buffer;
+    usize pos = 0;
+
+public:
+    record_reader(std::string_view buffer) : buffer{buffer} {}
+
+    // fills rec with the next non-empty record, false at end of buffer
+    bool next(record &rec) {
+        while(pos < buffer.size()) {
+            const char *start = buffer.data() + pos;
+            usize remaining = buffer.size() - pos;
+
+            const char *nl = (const char *)memchr(start, '\n', remaining);
+            usize len = nl ? (usize)(nl - start) : remaining;
+            pos += len + (nl ? 1 : 0);
+
+            if(make_record(std::string_view(start, len), rec)) return true;
+        }
+
+        return false;
+    }
+
+    // fills rec from one line (without its '\n'), false if the line holds no record
+    static bool make_record(std::string_view line, record &rec) {
+        // drop the trailing '\r' of windows line endings
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if(line.empty()) return false;
+
+        rec.raw = line;
+        rec.plain = memchr(line.data(), '^', line.size()) == nullptr &&
+                    memchr(line.data(), '\r', line.size()) == nullptr;
+
+        // a line made only of separators is as good as empty
+        return rec.plain || rec.length() != 0;
+    }
+};
+
+// record_reader for a stream (stdin, a pipe...) that can't be mapped.
+// reads a block at a time into one reusable buffer, so a record only stays
+// valid until the next call to next()
+class stream_record_reader
+{
+private:
+    FILE *in;
+    vector<char> buffer;
+    usize begin = 0; // unread data is [begin, end)
+    usize end = 0;
+    bool eof = false;
+
+public:
+    stream_record_reader(FILE *in) : in{in}, buffer(64 * 1024) {}
+
+    // fills rec with the next non-empty record, false at end of stream
+    bool next(record &rec) {
+        while(true) {
+            const char *start = buffer.data() + begin;
+            usize remaining = end - begin;
+
+            const char *nl = (const char *)memchr(start, '\n', remaining);
+
+            // no complete line buffered yet
+            if(!nl && !eof) {
+                refill();
+                continue;
+            }
+
+            if(remaining == 0) return false;
+
+            usize len = nl ? (usize)(nl - start) : remaining;
+            begin += len + (nl ? 1 : 0);
+
+            if(record_reader::make_record(std::string_view(start, len), rec)) return true;
+        }
+    }
+
+private:
+    void refill() {
+        // keep the partial line, grow only when a single line fills the whole buffer
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+
+        if(end == buffer.size()) buffer.resize(buffer.size() * 2);
+
+        usize n = fread(buffer.data() + end, 1, buffer.size() - end, in);
+        end += n;
+
+        if(n == 0) {
+            if(ferror(in)) throw ylib::Error("couldn't read the input stream");
+            eof = true;
+        }
+    }
+};
+
+} // namespace sic
+
+#endif // RECORD_READER_H
@@ -0,0 +1,172 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "../core/defines.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#if IPLATFORM_WINDOWS
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+namespace sic {
+
+// what a run did, for --stats: wall time per phase (in run order) and named counters.
+// the tools tally their counters in plain members while they work and only copy
+// them in here at the end, nothing in this class is on a hot path.
+class run_stats
+{
+private:
+    using clock = std::chrono::steady_clock;
+
+    vector<std::pair<string, f64>> phases;   // seconds
+    vector<std::pair<string, u64>> counters;
+
+    string current; // running phase ("" = none)
+    clock::time_point started;
+
+    static void put_json_string(string &out, const string &str) {
+        out += '"';
+        for(char c : str) {
+            if(c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            }
+            else if((u8)c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            }
+            else out += c;
+        }
+        out += '"';
+    }
+
+public:
+    // ends the running phase (if any) and starts timing this one
+    void begin(const string &name) {
+        end();
+        current = name;
+        started = clock::now();
+    }
+
+    void end() {
+        if(current.empty()) return;
+
+        f64 secs = std::chrono::duration<f64>(clock::now() - started).count();
+        add_time(current, secs);
+        current.clear();
+    }
+
+    // a phase that ran more than once adds up
+    void add_time(const string &name, f64 secs) {
+        for(auto &[phase, total] : phases) {
+            if(phase == name) {
+                total += secs;
+                return;
+            }
+        }
+        phases.push_back({name, secs});
+    }
+
+    void set(const string &name, u64 val) {
+        for(auto &[counter, value] : counters) {
+            if(counter == name) {
+                value = val;
+                return;
+            }
+        }
+        counters.push_back({name, val});
+    }
+
+    f64 total_time() const {
+        f64 total = 0;
+        for(const auto &[name, secs] : phases) total += secs;
+        return total;
+    }
+
+    // largest resident set of the whole process so far, in bytes (0 if unknown)
+    static u64 peak_rss() {
+#if IPLATFORM_WINDOWS
+        PROCESS_MEMORY_COUNTERS mem;
+        if(!GetProcessMemoryInfo(GetCurrentProcess(), &mem, sizeof(mem))) return 0;
+        return mem.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #if defined(__APPLE__)
+        return usage.ru_maxrss;        // bytes
+    #else
+        return (u64)usage.ru_maxrss * 1024; // kilobytes
+    #endif
+#endif
+    }
+
+    // one line per phase / counter
+    string to_text() const {
+        string out;
+        char buf[96];
+
+        for(const auto &[name, secs] : phases) {
+            snprintf(buf, sizeof(buf), "\t%-22s %10.3f ms\n", name.c_str(), secs * 1000);
+            out += buf;
+        }
+        snprintf(buf, sizeof(buf), "\t%-22s %10.3f ms\n", "total", total_time() * 1000);
+        out += buf;
+
+        for(const auto &[name, value] : counters) {
+            snprintf(buf, sizeof(buf), "\t%-22s %14llu\n", name.c_str(), value);
+            out += buf;
+        }
+
+        snprintf(buf, sizeof(buf), "\t%-22s %14llu\n", "peak_rss_bytes", peak_rss());
+        out += buf;
+
+        return out;
+    }
+
+    // one json object on one line:
+    // {"tool":..,"inputs":[..],"phases":{"name":seconds,..,"total":..},"counters":{..},"peak_rss_bytes":..}
+    string to_json(const string &tool, const vector<string> &inputs) const {
+        string out = "{\"tool\":";
+        put_json_string(out, tool);
+
+        out += ",\"inputs\":[";
+        for(usize i = 0; i < inputs.size(); i++) {
+            if(i) out += ',';
+            put_json_string(out, inputs[i]);
+        }
+
+        char num[32];
+        out += "],\"phases\":{";
+        for(const auto &[name, secs] : phases) {
+            put_json_string(out, name);
+            snprintf(num, sizeof(num), ":%.6f,", secs);
+            out += num;
+        }
+        snprintf(num, sizeof(num), "\"total\":%.6f}", total_time());
+        out += num;
+
+        out += ",\"counters\":{";
+        for(usize i = 0; i < counters.size(); i++) {
+            if(i) out += ',';
+            put_json_string(out, counters[i].first);
+            snprintf(num, sizeof(num), ":%llu", counters[i].second);
+            out += num;
+        }
+
+        snprintf(num, sizeof(num), "},\"peak_rss_bytes\":%llu}", peak_rss());
+        out += num;
+
+        return out;
+    }
+};
+
+} // namespace sic
+
+#endif // STATS_H
@@ -0,0 +1,177 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "../core/defines.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace sic {
+
+// fixed-size work-stealing thread pool.
+// every worker owns a deque: it pops its own work from the back and, when it runs
+// dry, steals from the front of the others. submit() spreads tasks round-robin.
+class thread_pool
+{
+private:
+    struct work_queue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    vector<std::thread> workers;
+    vector<std::unique_ptr<work_queue>> queues;
+
+    std::mutex state_lock;
+    std::condition_variable work_ready; // something was queued (or we are stopping)
+    std::condition_variable all_done;   // pending dropped to zero
+
+    usize queued = 0;  // tasks sitting in the queues
+    usize pending = 0; // tasks submitted but not finished
+    bool stopping = false;
+
+    std::atomic<usize> next_queue{0};
+    std::exception_ptr first_error; // rethrown by wait()
+
+public:
+    // threads = 0 -> one per hardware thread
+    thread_pool(usize threads = 0) {
+        if(threads == 0) threads = default_threads();
+
+        for(usize i = 0; i < threads; i++) {
+            queues.push_back(std::make_unique<work_queue>());
+        }
+
+        for(usize i = 0; i < threads; i++) {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(state_lock);
+            stopping = true;
+        }
+        work_ready.notify_all();
+
+        for(auto &worker : workers) worker.join();
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    static usize default_threads() {
+        usize hw = std::thread::hardware_concurrency();
+        return hw ? hw : 1;
+    }
+
+    usize size() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        work_queue &q = *queues[next_queue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(q.lock);
+            q.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_lock);
+            queued++;
+            pending++;
+        }
+        work_ready.notify_one();
+    }
+
+    // blocks until every submitted task ran, rethrows the first exception a task threw
+    void wait() {
+        std::unique_lock<std::mutex> lock(state_lock);
+        all_done.wait(lock, [this] { return pending == 0; });
+
+        if(first_error) {
+            std::exception_ptr err = first_error;
+            first_error = nullptr;
+            std::rethrow_exception(err);
+        }
+    }
+
+    // runs fn(i) for i in [0, n) on the pool and waits for all of them
+    template<typename F>
+    void parallel_for(usize n, F fn) {
+        for(usize i = 0; i < n; i++) {
+            submit([&fn, i] { fn(i); });
+        }
+        wait();
+    }
+
+private:
+    bool pop(usize self, std::function<void()> &task) {
+        // own queue first (lifo, still warm in cache)
+        {
+            work_queue &q = *queues[self];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if(!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // then steal the oldest task of somebody else
+        for(usize k = 1; k < queues.size(); k++) {
+            work_queue &q = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if(!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void worker_loop(usize self) {
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(state_lock);
+                work_ready.wait(lock, [this] { return queued > 0 || stopping; });
+
+                if(queued == 0) return; // stopping and drained
+
+                // claim one task: tasks are queued before they are counted,
+                // so a claimed task is always sitting in some queue
+                queued--;
+            }
+
+            std::function<void()> task;
+            while(!pop(self, task)) {
+                std::this_thread::yield();
+            }
+
+            try {
+                task();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(state_lock);
+                if(!first_error) first_error = std::current_exception();
+            }
+
+            bool finished;
+            {
+                std::lock_guard<std::mutex> lock(state_lock);
+                finished = --pending == 0;
+            }
+            if(finished) all_done.notify_all();
+        }
+    }
+};
+
+} // namespace sic
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,530 @@
+#include "vm.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+// helpers
+namespace {
+
+constexpr u32 WORD_MASK = 0xFFFFFF; // registers and words are 24 bits
+
+// condition code in SW (bits 6-7)
+constexpr u32 CC_MASK = 0xC0;
+constexpr u32 CC_LT = 0x00;
+constexpr u32 CC_EQ = 0x40;
+constexpr u32 CC_GT = 0x80;
+
+// opcode byte (n i bits cleared) -> handler
+constexpr std::array<u8, 256> make_op_ids() {
+    std::array<u8, 256> ids{};
+    for(u8 &id : ids) id = sic::OP_INVALID;
+
+    #define SIC_OPCODE(name, opc, fmt) ids[opc] = sic::OP_##name;
+    #include "../dasm/opcodes.def"
+    #undef SIC_OPCODE
+
+    return ids;
+}
+
+constexpr std::array<u8, 256> op_ids = make_op_ids();
+
+// 24 bit two's complement -> i32
+inline i32 sext(u32 val) {
+    return (i32)(val << 8) >> 8;
+}
+
+// SIC/XE float (48 bits): sign, 11 bit exponent (excess 1024), 36 bit fraction.
+// value = 0.fraction * 2^(exponent - 1024)
+double float_from_bits(u64 bits) {
+    u64 frac = bits & ((1ULL << 36) - 1);
+    i32 exp = (bits >> 36) & 0x7FF;
+    if(frac == 0) return 0.0;
+
+    double val = std::ldexp((double)frac, exp - 1024 - 36);
+    return (bits >> 47) & 1 ? -val : val;
+}
+
+u64 float_to_bits(double val) {
+    if(val == 0.0 || !std::isfinite(val)) return 0;
+
+    u64 sign = val < 0 ? 1 : 0;
+    i32 exp;
+    double mant = std::frexp(std::fabs(val), &exp); // [0.5, 1)
+
+    i32 biased = std::clamp(exp + 1024, 0, 0x7FF);
+    u64 frac = (u64)std::ldexp(mant, 36) & ((1ULL << 36) - 1);
+
+    return (sign << 47) | ((u64)biased << 36) | frac;
+}
+
+} // namespace
+
+const sic::vm::handler sic::vm::handlers[OP_COUNT] = {
+    &vm::exec_invalid, // OP_DECODE, never dispatched (loop() decodes first)
+    &vm::exec_invalid,
+#define SIC_OPCODE(name, opc, fmt) &vm::exec_##name,
+#include "../dasm/opcodes.def"
+#undef SIC_OPCODE
+};
+
+// public functions
+sic::vm::vm() : memory(MEMORY_SIZE, 0), cache(MEMORY_SIZE) {}
+
+u32 sic::vm::load_image(const string &filepath) {
+    mapped_file file(filepath);
+    std::string_view view = file.view();
+    const u8 *data = reinterpret_cast<const u8 *>(view.data());
+
+    std::fill(memory.begin(), memory.end(), 0);
+    std::fill(cache.begin(), cache.end(), decoded_op{});
+
+    auto get32 = [&](usize at) {
+        return (u32)data[at] | ((u32)data[at + 1] << 8) | ((u32)data[at + 2] << 16) | ((u32)data[at + 3] << 24);
+    };
+
+    // segmented image (see linker::write_segmented)
+    if(view.size() >= 24 && view.substr(0, 4) == "SXSG") {
+        u32 entry = get32(8);
+        u32 count = get32(20);
+
+        if(view.size() < 24 + (u64)count * 16) {
+            throw ylib::Error("vm: truncated segment table in " + filepath);
+        }
+
+        for(u32 i = 0; i < count; i++) {
+            usize at = 24 + (usize)i * 16;
+            u32 addr = get32(at);
+            u32 size = get32(at + 4);
+            u64 offset = get32(at + 8) | ((u64)get32(at + 12) << 32);
+
+            if((u64)addr + size > MEMORY_SIZE || offset + size > view.size()) {
+                throw ylib::Error("vm: segment out of range in " + filepath);
+            }
+
+            memcpy(memory.data() + addr, data + offset, size);
+        }
+
+        return entry & ADDR_MASK;
+    }
+
+    // raw image: file offset = address
+    if(view.size() > MEMORY_SIZE) {
+        throw ylib::Error("vm: image " + filepath + " is larger than the SIC/XE memory");
+    }
+
+    if(!view.empty()) memcpy(memory.data(), data, view.size());
+    return 0;
+}
+
+sic::vm_stop sic::vm::run(u32 entry) {
+    regs.fill(0);
+    freg = 0;
+    regs[REG_L] = RETURN_ADDR;
+    regs[REG_PC] = entry & ADDR_MASK;
+
+    steps = 0;
+    stop = vm_stop::running;
+    fault_msg.clear();
+
+    if(profile) hits.assign(MEMORY_SIZE, 0);
+
+    // WD output goes straight to stdout, after anything logged before
+    Logger::Flush();
+
+    if(profile) loop<true>();
+    else loop<false>();
+
+    device_out.flush();
+    return stop;
+}
+
+vector<std::pair<u32, u64>> sic::vm::hot_addresses(usize count) const {
+    vector<std::pair<u32, u64>> hot;
+    for(u32 addr = 0; addr < hits.size(); addr++) {
+        if(hits[addr]) hot.push_back({addr, hits[addr]});
+    }
+
+    count = std::min(count, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + count, hot.end(),
+                      [](const auto &a, const auto &b) { return a.second > b.second || (a.second == b.second && a.first < b.first); });
+    hot.resize(count);
+
+    return hot;
+}
+
+// private functions
+template<bool PROFILE>
+void sic::vm::loop() {
+    while(stop == vm_stop::running) {
+        u32 pc = regs[REG_PC];
+        if(cache[pc].handler == OP_DECODE) decode(pc);
+
+        // a copy: the handler may write over (and invalidate) its own slot
+        decoded_op op = cache[pc];
+        if constexpr(PROFILE) hits[pc]++;
+
+        regs[REG_PC] = (pc + op.len) & ADDR_MASK;
+        handlers[op.handler](*this, op);
+
+        if(++steps == max_steps && stop == vm_stop::running) {
+            stop = vm_stop::step_limit;
+        }
+    }
+}
+
+template void sic::vm::loop<true>();
+template void sic::vm::loop<false>();
+
+void sic::vm::decode(u32 addr) {
+    u8 bytes[4];
+    for(u32 i = 0; i < 4; i++) bytes[i] = read_byte(addr + i);
+
+    decoded_op entry{};
+    entry.handler = OP_INVALID;
+    entry.len = 1;
+
+    u8 opcode = bytes[0] & 0xFC;
+    const op::instruction &inst = op::builtin_table[opcode];
+
+    if(inst.format == 3 && (bytes[0] & 3) == 0) {
+        // n = i = 0: plain SIC, [opcode][x][15 bit address] (no fmt 4 either)
+        entry.handler = op_ids[opcode];
+        entry.len = 3;
+        entry.target = ((bytes[1] & 0x7F) << 8) | bytes[2];
+        if(bytes[1] & 0x80) entry.mode |= ADDR_INDEXED;
+    }
+    else {
+        // the rest decodes exactly like the disassembler sees it
+        asmline line = dasm::decode_bytes(bytes, addr, MEMORY_SIZE);
+
+        if(line.kind != operand_kind::data_byte && line.len > 0) {
+            entry.handler = op_ids[line.opcode];
+            entry.len = line.len;
+
+            if(line.kind == operand_kind::registers) {
+                entry.regs = line.value;
+            }
+            else if(line.kind == operand_kind::immediate || line.kind == operand_kind::memory) {
+                if(line.flags & (LINE_EXTENDED | LINE_PC_REL)) {
+                    entry.target = line.value & ADDR_MASK;
+                }
+                else {
+                    // direct or base relative: 12 bit unsigned displacement
+                    entry.target = line.value & 0xFFF;
+                    if(line.flags & LINE_BASE_REL) entry.mode |= ADDR_BASE;
+                }
+
+                if(line.kind == operand_kind::immediate) entry.mode |= ADDR_IMMEDIATE;
+                if(line.flags & LINE_INDIRECT) entry.mode |= ADDR_INDIRECT;
+                if(line.flags & LINE_INDEXED) entry.mode |= ADDR_INDEXED;
+            }
+        }
+    }
+
+    cache[addr] = entry;
+}
+
+void sic::vm::invalidate(u32 addr, u32 n) {
+    // an instruction is up to 4 bytes, so the ones starting 3 bytes before are hit too
+    for(u32 i = 0; i < n + 3; i++) {
+        cache[(addr - 3 + i) & ADDR_MASK].handler = OP_DECODE;
+    }
+}
+
+// --- memory ---
+u32 sic::vm::read_word(u32 addr) const {
+    return ((u32)read_byte(addr) << 16) | ((u32)read_byte(addr + 1) << 8) | read_byte(addr + 2);
+}
+
+u64 sic::vm::read_float(u32 addr) const {
+    u64 bits = 0;
+    for(u32 i = 0; i < 6; i++) bits = (bits << 8) | read_byte(addr + i);
+    return bits;
+}
+
+void sic::vm::write_byte(u32 addr, u8 val) {
+    memory[addr & ADDR_MASK] = val;
+    invalidate(addr, 1);
+}
+
+void sic::vm::write_word(u32 addr, u32 val) {
+    memory[addr & ADDR_MASK]       = (val >> 16) & 0xFF;
+    memory[(addr + 1) & ADDR_MASK] = (val >> 8) & 0xFF;
+    memory[(addr + 2) & ADDR_MASK] = val & 0xFF;
+    invalidate(addr, 3);
+}
+
+void sic::vm::write_float(u32 addr, u64 bits) {
+    for(u32 i = 0; i < 6; i++) {
+        memory[(addr + i) & ADDR_MASK] = (bits >> (40 - 8 * i)) & 0xFF;
+    }
+    invalidate(addr, 6);
+}
+
+// --- operands ---
+u32 sic::vm::target_of(const decoded_op &op) const {
+    u32 ta = op.target;
+    if(op.mode & ADDR_BASE) ta += regs[REG_B];
+    if(op.mode & ADDR_INDEXED) ta += regs[REG_X];
+
+    if(op.mode & ADDR_IMMEDIATE) return ta & WORD_MASK;
+
+    ta &= ADDR_MASK;
+    if(op.mode & ADDR_INDIRECT) ta = read_word(ta) & ADDR_MASK;
+    return ta;
+}
+
+u32 sic::vm::word_operand(const decoded_op &op) const {
+    if(op.mode & ADDR_IMMEDIATE) return target_of(op);
+    return read_word(target_of(op));
+}
+
+u8 sic::vm::byte_operand(const decoded_op &op) const {
+    if(op.mode & ADDR_IMMEDIATE) return target_of(op) & 0xFF;
+    return read_byte(target_of(op));
+}
+
+double sic::vm::float_operand(const decoded_op &op) const {
+    if(op.mode & ADDR_IMMEDIATE) return (double)target_of(op);
+    return float_from_bits(read_float(target_of(op)));
+}
+
+// --- flow ---
+void sic::vm::jump(const decoded_op &op, u32 to) {
+    // J * is how SIC programs stop
+    if(to == current(op)) stop = vm_stop::halted;
+    regs[REG_PC] = to & ADDR_MASK;
+}
+
+void sic::vm::set_cc(i32 lhs, i32 rhs) {
+    u32 cc = lhs < rhs ? CC_LT : (lhs == rhs ? CC_EQ : CC_GT);
+    regs[REG_SW] = (regs[REG_SW] & ~CC_MASK) | cc;
+}
+
+i32 sic::vm::cc() const {
+    u32 cc = regs[REG_SW] & CC_MASK;
+    return cc == CC_LT ? -1 : (cc == CC_EQ ? 0 : 1);
+}
+
+void sic::vm::fail(const decoded_op &op, const string &msg) {
+    stop = vm_stop::fault;
+    fault_msg = msg;
+    fault_addr = current(op);
+    regs[REG_PC] = fault_addr;
+}
+
+// --- handlers ---
+// fmt 2 operands
+#define R1(op) ((op).regs >> 4)
+#define R2(op) ((op).regs & 0xF)
+
+void sic::vm::exec_invalid(vm &m, const decoded_op &op) {
+    m.fail(op, "invalid instruction");
+}
+
+// arithmetic / logic
+void sic::vm::exec_ADD(vm &m, const decoded_op &op) {
+    m.regs[REG_A] = (m.regs[REG_A] + m.word_operand(op)) & WORD_MASK;
+}
+
+void sic::vm::exec_SUB(vm &m, const decoded_op &op) {
+    m.regs[REG_A] = (m.regs[REG_A] - m.word_operand(op)) & WORD_MASK;
+}
+
+void sic::vm::exec_MUL(vm &m, const decoded_op &op) {
+    m.regs[REG_A] = (u32)((i64)sext(m.regs[REG_A]) * sext(m.word_operand(op))) & WORD_MASK;
+}
+
+void sic::vm::exec_DIV(vm &m, const decoded_op &op) {
+    i32 div = sext(m.word_operand(op));
+    if(div == 0) return m.fail(op, "division by zero");
+
+    m.regs[REG_A] = (u32)(sext(m.regs[REG_A]) / div) & WORD_MASK;
+}
+
+void sic::vm::exec_AND(vm &m, const decoded_op &op) {
+    m.regs[REG_A] &= m.word_operand(op);
+}
+
+void sic::vm::exec_OR(vm &m, const decoded_op &op) {
+    m.regs[REG_A] = (m.regs[REG_A] | m.word_operand(op)) & WORD_MASK;
+}
+
+void sic::vm::exec_COMP(vm &m, const decoded_op &op) {
+    m.set_cc(sext(m.regs[REG_A]), sext(m.word_operand(op)));
+}
+
+void sic::vm::exec_TIX(vm &m, const decoded_op &op) {
+    m.regs[REG_X] = (m.regs[REG_X] + 1) & WORD_MASK;
+    m.set_cc(sext(m.regs[REG_X]), sext(m.word_operand(op)));
+}
+
+// register to register
+void sic::vm::exec_ADDR(vm &m, const decoded_op &op) {
+    m.regs[R2(op)] = (m.regs[R2(op)] + m.regs[R1(op)]) & WORD_MASK;
+}
+
+void sic::vm::exec_SUBR(vm &m, const decoded_op &op) {
+    m.regs[R2(op)] = (m.regs[R2(op)] - m.regs[R1(op)]) & WORD_MASK;
+}
+
+void sic::vm::exec_MULR(vm &m, const decoded_op &op) {
+    m.regs[R2(op)] = (u32)((i64)sext(m.regs[R2(op)]) * sext(m.regs[R1(op)])) & WORD_MASK;
+}
+
+void sic::vm::exec_DIVR(vm &m, const decoded_op &op) {
+    i32 div = sext(m.regs[R1(op)]);
+    if(div == 0) return m.fail(op, "division by zero");
+
+    m.regs[R2(op)] = (u32)(sext(m.regs[R2(op)]) / div) & WORD_MASK;
+}
+
+void sic::vm::exec_COMPR(vm &m, const decoded_op &op) {
+    m.set_cc(sext(m.regs[R1(op)]), sext(m.regs[R2(op)]));
+}
+
+void sic::vm::exec_RMO(vm &m, const decoded_op &op) {
+    m.regs[R2(op)] = m.regs[R1(op)];
+}
+
+void sic::vm::exec_CLEAR(vm &m, const decoded_op &op) {
+    m.regs[R1(op)] = 0;
+}
+
+void sic::vm::exec_TIXR(vm &m, const decoded_op &op) {
+    m.regs[REG_X] = (m.regs[REG_X] + 1) & WORD_MASK;
+    m.set_cc(sext(m.regs[REG_X]), sext(m.regs[R1(op)]));
+}
+
+void sic::vm::exec_SHIFTL(vm &m, const decoded_op &op) {
+    // circular, by r2 + 1 bits
+    u32 n = R2(op) + 1;
+    u32 val = m.regs[R1(op)];
+    m.regs[R1(op)] = ((val << n) | (val >> (24 - n))) & WORD_MASK;
+}
+
+void sic::vm::exec_SHIFTR(vm &m, const decoded_op &op) {
+    // arithmetic (the sign bit is copied in), by r2 + 1 bits
+    u32 n = R2(op) + 1;
+    m.regs[R1(op)] = (u32)(sext(m.regs[R1(op)]) >> n) & WORD_MASK;
+}
+
+// loads / stores
+void sic::vm::exec_LDA(vm &m, const decoded_op &op) { m.regs[REG_A] = m.word_operand(op); }
+void sic::vm::exec_LDB(vm &m, const decoded_op &op) { m.regs[REG_B] = m.word_operand(op); }
+void sic::vm::exec_LDL(vm &m, const decoded_op &op) { m.regs[REG_L] = m.word_operand(op); }
+void sic::vm::exec_LDS(vm &m, const decoded_op &op) { m.regs[REG_S] = m.word_operand(op); }
+void sic::vm::exec_LDT(vm &m, const decoded_op &op) { m.regs[REG_T] = m.word_operand(op); }
+void sic::vm::exec_LDX(vm &m, const decoded_op &op) { m.regs[REG_X] = m.word_operand(op); }
+
+void sic::vm::exec_LDCH(vm &m, const decoded_op &op) {
+    m.regs[REG_A] = (m.regs[REG_A] & 0xFFFF00) | m.byte_operand(op);
+}
+
+void sic::vm::exec_STA(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_A]); }
+void sic::vm::exec_STB(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_B]); }
+void sic::vm::exec_STL(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_L]); }
+void sic::vm::exec_STS(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_S]); }
+void sic::vm::exec_STT(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_T]); }
+void sic::vm::exec_STX(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_X]); }
+void sic::vm::exec_STSW(vm &m, const decoded_op &op) { m.write_word(m.target_of(op), m.regs[REG_SW]); }
+
+void sic::vm::exec_STCH(vm &m, const decoded_op &op) {
+    m.write_byte(m.target_of(op), m.regs[REG_A] & 0xFF);
+}
+
+// jumps
+void sic::vm::exec_J(vm &m, const decoded_op &op) {
+    m.jump(op, m.target_of(op));
+}
+
+void sic::vm::exec_JEQ(vm &m, const decoded_op &op) {
+    if(m.cc() == 0) m.jump(op, m.target_of(op));
+}
+
+void sic::vm::exec_JGT(vm &m, const decoded_op &op) {
+    if(m.cc() > 0) m.jump(op, m.target_of(op));
+}
+
+void sic::vm::exec_JLT(vm &m, const decoded_op &op) {
+    if(m.cc() < 0) m.jump(op, m.target_of(op));
+}
+
+void sic::vm::exec_JSUB(vm &m, const decoded_op &op) {
+    u32 to = m.target_of(op);
+    m.regs[REG_L] = m.regs[REG_PC];
+    m.jump(op, to);
+}
+
+void sic::vm::exec_RSUB(vm &m, const decoded_op &) {
+    // returning from the program itself
+    if(m.regs[REG_L] == RETURN_ADDR) {
+        m.stop = vm_stop::returned;
+        return;
+    }
+
+    m.regs[REG_PC] = m.regs[REG_L] & ADDR_MASK;
+}
+
+// floating point (F is kept as a double)
+void sic::vm::exec_LDF(vm &m, const decoded_op &op) { m.freg = m.float_operand(op); }
+void sic::vm::exec_ADDF(vm &m, const decoded_op &op) { m.freg += m.float_operand(op); }
+void sic::vm::exec_SUBF(vm &m, const decoded_op &op) { m.freg -= m.float_operand(op); }
+void sic::vm::exec_MULF(vm &m, const decoded_op &op) { m.freg *= m.float_operand(op); }
+
+void sic::vm::exec_DIVF(vm &m, const decoded_op &op) {
+    double div = m.float_operand(op);
+    if(div == 0.0) return m.fail(op, "division by zero");
+
+    m.freg /= div;
+}
+
+void sic::vm::exec_COMPF(vm &m, const decoded_op &op) {
+    double val = m.float_operand(op);
+    m.set_cc(m.freg < val ? -1 : (m.freg > val ? 1 : 0), 0);
+}
+
+void sic::vm::exec_STF(vm &m, const decoded_op &op) {
+    m.write_float(m.target_of(op), float_to_bits(m.freg));
+}
+
+void sic::vm::exec_FIX(vm &m, const decoded_op &) {
+    m.regs[REG_A] = (u32)(i32)m.freg & WORD_MASK;
+}
+
+void sic::vm::exec_FLOAT(vm &m, const decoded_op &) {
+    m.freg = (double)sext(m.regs[REG_A]);
+}
+
+void sic::vm::exec_NORM(vm &, const decoded_op &) {
+    // F is always normalized here
+}
+
+// devices: RD <- stdin, WD -> stdout, TD always ready
+void sic::vm::exec_TD(vm &m, const decoded_op &) {
+    m.set_cc(-1, 0); // '<' = ready
+}
+
+void sic::vm::exec_RD(vm &m, const decoded_op &) {
+    m.device_out.flush(); // prompts go out before we wait for input
+
+    i32 c = getchar();
+    m.regs[REG_A] = (m.regs[REG_A] & 0xFFFF00) | (c == EOF ? 0 : (u8)c);
+}
+
+void sic::vm::exec_WD(vm &m, const decoded_op &) {
+    m.device_out.put((char)(m.regs[REG_A] & 0xFF));
+}
+
+// privileged / i/o channel instructions: nothing to do for a user program
+void sic::vm::exec_HIO(vm &, const decoded_op &) {}
+void sic::vm::exec_SIO(vm &, const decoded_op &) {}
+void sic::vm::exec_TIO(vm &, const decoded_op &) {}
+void sic::vm::exec_LPS(vm &, const decoded_op &) {}
+void sic::vm::exec_SSK(vm &, const decoded_op &) {}
+void sic::vm::exec_STI(vm &, const decoded_op &) {}
+void sic::vm::exec_SVC(vm &, const decoded_op &) {}
+
+#undef R1
+#undef R2
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "../core/logger.h"
+#include "../core/error.h"
+
+#include "../dasm/dasm.h"
+#include "../util/file_writer.h"
+
+#include <array>
+
+namespace sic {
+
+// register numbers, as fmt 2 instructions encode them (see op::reg_names)
+enum vm_reg : u8 {
+    REG_A  = 0,
+    REG_X  = 1,
+    REG_L  = 2,
+    REG_B  = 3,
+    REG_S  = 4,
+    REG_T  = 5,
+    REG_F  = 6, // kept as a double in vm::freg, this slot is unused
+    REG_PC = 8,
+    REG_SW = 9,
+};
+
+// one handler per instruction of opcodes.def, plus the two special ones
+enum vm_op : u8 {
+    OP_DECODE = 0, // cache entry not filled (or invalidated by a write)
+    OP_INVALID,    // bytes that don't decode to an instruction
+#define SIC_OPCODE(name, opc, fmt) OP_##name,
+#include "../dasm/opcodes.def"
+#undef SIC_OPCODE
+    OP_COUNT
+};
+
+// how a fmt 3/4 instruction gets its target address / operand
+#define ADDR_BASE      BIT(0) // + B (base relative)
+#define ADDR_INDEXED   BIT(1) // + X
+#define ADDR_IMMEDIATE BIT(2) // the target address is the operand
+#define ADDR_INDIRECT  BIT(3) // the target address holds the real one
+
+// the predecoded instruction at one address: everything known without running it
+struct decoded_op {
+    u8 handler; // vm_op
+    u8 len;
+    u8 mode;    // ADDR_* bits
+    u8 regs;    // fmt 2: r1 << 4 | r2
+    u32 target; // address (pc relative already resolved) or base displacement
+};
+
+// why run() returned
+enum class vm_stop : u8 {
+    running,
+    halted,     // J to itself, the usual end of a SIC program
+    returned,   // RSUB from the outermost routine
+    step_limit, // ran the maximum number of instructions
+    fault,      // invalid instruction, division by zero
+};
+
+// SIC/XE machine that runs a linked memory image.
+// every address has a slot in a predecode cache: an instruction is decoded (with the
+// disassembler's decoder) the first time it runs, after that each step is a cache load
+// and a call through the handler table. writes drop the slots they overlap, so
+// self-modifying code is decoded again.
+// devices: RD reads stdin, WD writes stdout, TD is always ready.
+class vm {
+public:
+    static constexpr u32 MEMORY_SIZE = 1 << 20; // 20 bit addresses (fmt 4)
+    static constexpr u32 ADDR_MASK = MEMORY_SIZE - 1;
+    static constexpr u32 RETURN_ADDR = 0xFFFFFF; // L at start, RSUB to it ends the run
+
+    using handler = void (*)(vm &m, const decoded_op &op);
+
+private:
+    vector<u8> memory;
+    vector<decoded_op> cache; // one slot per address
+    vector<u64> hits;         // executions per address (only with profiling)
+
+    std::array<u32, 16> regs{}; // indexed by vm_reg (24 bit values)
+    double freg = 0;            // F
+
+    u64 steps = 0;
+    u64 max_steps = 0; // 0 = no limit
+    bool profile = false;
+
+    vm_stop stop = vm_stop::running;
+    string fault_msg;
+    u32 fault_addr = 0;
+
+    file_writer device_out{stdout, "stdout"};
+
+    static const handler handlers[OP_COUNT];
+
+    // predecoder
+    void decode(u32 addr);
+    void invalidate(u32 addr, u32 n);
+
+    template<bool PROFILE>
+    void loop();
+
+    // memory (wraps at MEMORY_SIZE)
+    u8 read_byte(u32 addr) const { return memory[addr & ADDR_MASK]; }
+    u32 read_word(u32 addr) const;
+    u64 read_float(u32 addr) const;
+    void write_byte(u32 addr, u8 val);
+    void write_word(u32 addr, u32 val);
+    void write_float(u32 addr, u64 bits);
+
+    // operands
+    u32 target_of(const decoded_op &op) const;
+    u32 word_operand(const decoded_op &op) const;
+    u8 byte_operand(const decoded_op &op) const;
+    double float_operand(const decoded_op &op) const;
+
+    // flow
+    u32 current(const decoded_op &op) const { return (regs[REG_PC] - op.len) & ADDR_MASK; }
+    void jump(const decoded_op &op, u32 to);
+    void set_cc(i32 lhs, i32 rhs);
+    i32 cc() const;
+    void fail(const decoded_op &op, const string &msg);
+
+    // handlers
+    static void exec_invalid(vm &m, const decoded_op &op);
+#define SIC_OPCODE(name, opc, fmt) static void exec_##name(vm &m, const decoded_op &op);
+#include "../dasm/opcodes.def"
+#undef SIC_OPCODE
+
+public:
+    vm();
+
+    // raw image (address 0 = first byte) or a segmented one (link --format seg).
+    // returns the entry point (from the seg header, else 0)
+    u32 load_image(const string &filepath);
+
+    void set_max_steps(u64 count) { max_steps = count; }
+    void set_profile(bool on) { profile = on; }
+
+    // runs from entry until the program stops (see vm_stop)
+    vm_stop run(u32 entry);
+
+    u64 get_steps() const { return steps; }
+    u32 get_reg(vm_reg r) const { return regs[r]; }
+    double get_freg() const { return freg; }
+    const string &get_fault() const { return fault_msg; }
+    u32 get_fault_addr() const { return fault_addr; }
+
+    // the count most executed addresses, most executed first
+    vector<std::pair<u32, u64>> hot_addresses(usize count) const;
+};
+
+} // namespace sic
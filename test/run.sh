@@ -0,0 +1,159 @@
+#!/bin/bash
+# fixture checks: runs the tools over the inputs in test/ and compares what they
+# write with the expected output stored next to them (<input>_<what>.txt).
+#
+#   ./build.sh test        (builds bin/ysicxe, then runs this)
+#   test/run.sh
+#
+# exits non-zero if any check failed. YSICXE overrides the binary.
+
+bin=${YSICXE:-bin/ysicxe}
+dir=$(dirname "$0")
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+failed=0
+
+pass() { echo "ok    $1"; }
+fail() { echo "FAIL  $1"; failed=$((failed + 1)); }
+
+# name, expected file, actual file
+check() {
+    if cmp -s "$2" "$3"; then
+        pass "$1"
+    else
+        fail "$1"
+        diff "$2" "$3" | head -10
+    fi
+}
+
+# name, command...: the command has to fail
+rejects() {
+    local name=$1
+    shift
+    if "$@" > /dev/null 2>&1; then fail "$name"; else pass "$name"; fi
+}
+
+# --- dasm ---
+$bin dasm -q $dir/testxy.obj -o $tmp/testxy.asm -s $tmp/testxy.sym
+check "dasm listing" $dir/testxy_asm.txt $tmp/testxy.asm
+check "dasm symtab" $dir/testxy_symtab.txt $tmp/testxy.sym
+
+# branchy.obj: a jump over inline data, a branch, a call-less return and a halt loop
+$bin dasm -q $dir/branchy.obj -o $tmp/branchy.asm -s $tmp/branchy.sym
+check "dasm listing (branchy)" $dir/branchy_asm.txt $tmp/branchy.asm
+check "dasm symtab (branchy)" $dir/branchy_symtab.txt $tmp/branchy.sym
+
+# --- dasm -r: only what the control flow reaches is code ---
+$bin dasm -q -r $dir/branchy.obj -o $tmp/branchy_r.asm -s $tmp/branchy_r.sym
+check "dasm -r listing" $dir/branchy_recursive_asm.txt $tmp/branchy_r.asm
+check "dasm -r symtab" $dir/branchy_recursive_symtab.txt $tmp/branchy_r.sym
+
+# --- dasm --batch: same output as one file at a time, a bad input doesn't stop the rest ---
+printf '%s\n' $dir/testxy.obj $dir/missing.obj $dir/branchy.obj > $tmp/batch.txt
+rejects "dasm --batch reports the missing file" $bin dasm -q --batch $tmp/batch.txt --out-dir $tmp/batch -j 2
+check "dasm --batch listing (testxy)" $dir/testxy_asm.txt $tmp/batch/testxy.asm
+check "dasm --batch symtab (testxy)" $dir/testxy_symtab.txt $tmp/batch/testxy.sym
+check "dasm --batch listing (branchy)" $dir/branchy_asm.txt $tmp/batch/branchy.asm
+check "dasm --batch symtab (branchy)" $dir/branchy_symtab.txt $tmp/batch/branchy.sym
+
+# --- dasm streaming ('-'): listing + symtab on stdout ---
+# a label only shows in the listing if it was referenced before its line came out
+$bin dasm - -o - < $dir/testxy.obj > $tmp/testxy_stream.txt
+check "dasm - -o - (testxy)" $dir/testxy_stream.txt $tmp/testxy_stream.txt
+
+# every reference in branchy.obj comes first, so it streams the full listing
+$bin dasm - -o - < $dir/branchy.obj > $tmp/branchy_stream.txt
+cat $dir/branchy_asm.txt $dir/branchy_symtab.txt > $tmp/branchy_expected.txt
+check "dasm - -o - (branchy)" $tmp/branchy_expected.txt $tmp/branchy_stream.txt
+
+$bin dasm -q - -o $tmp/stdin.asm -s $tmp/stdin.sym < $dir/branchy.obj
+check "dasm - (stdin to files)" $dir/branchy_asm.txt $tmp/stdin.asm
+
+# --- link ---
+abc=$dir/proga.obj,$dir/progb.obj,$dir/progc.obj
+
+$bin link -q -i $abc -a 4000 -o $tmp/abc.out -e $tmp/abc.est
+check "link estab" $dir/progabc_estab.txt $tmp/abc.est
+
+# progabc.obj holds the three of them as control sections of one file
+$bin link -q -i $dir/progabc.obj -a 4000 -o $tmp/abc_one.out -e $tmp/abc_one.est
+check "link multi-section file (image)" $tmp/abc.out $tmp/abc_one.out
+check "link multi-section file (estab)" $dir/progabc_estab.txt $tmp/abc_one.est
+
+# --- link output formats ---
+# at address 0 nothing is a hole: raw, sparse and the mmap build are all the same image
+$bin link -q -i $abc -o $tmp/abc0.raw
+check "link raw image" $dir/progabc_image.bin $tmp/abc0.raw
+$bin link -q -i $abc -o $tmp/abc0.sparse -f sparse
+check "link -f sparse image" $dir/progabc_image.bin $tmp/abc0.sparse
+$bin link -q -i $abc -o $tmp/abc0.mmap -m
+check "link -m image" $dir/progabc_image.bin $tmp/abc0.mmap
+
+$bin link -q -i $abc -a 4000 -o $tmp/abc.seg -f seg
+check "link -f seg image" $dir/progabc_seg.bin $tmp/abc.seg
+
+# at 4000 the first 4 pages were never written: holes (zeros) instead of FF fill
+$bin link -q -i $abc -a 4000 -o $tmp/abc.sparse -f sparse
+head -c 16384 /dev/zero > $tmp/holes
+tail -c +16385 $tmp/abc.out >> $tmp/holes
+check "link -f sparse holes" $tmp/holes $tmp/abc.sparse
+
+# --- link -c: a relink only reloads what changed, and ends up where a full link does ---
+mkdir -p $tmp/cached
+cp $dir/proga.obj $dir/progb.obj $dir/progc.obj $tmp/cached/
+cabc=$tmp/cached/proga.obj,$tmp/cached/progb.obj,$tmp/cached/progc.obj
+
+$bin link -q -i $cabc -a 4000 -o $tmp/cached.out -c $tmp/cache
+
+# one T byte and one D address of PROGB (same lengths, so the layout stays)
+sed -i -e 's/^T^000036^0B^03100000/T^000036^0B^07100000/' -e 's/^D^LISTB ^000060/D^LISTB ^000064/' $tmp/cached/progb.obj
+$bin link -q -i $cabc -a 4000 -o $tmp/fresh.out
+$bin link -q -i $cabc -a 4000 -o $tmp/cached.out -c $tmp/cache --stats=json > $tmp/cached.json
+
+if cmp -s $tmp/fresh.out $tmp/abc.out; then fail "link -c test input changed"; fi
+check "link -c relink == full link" $tmp/fresh.out $tmp/cached.out
+if grep -q '"objects_cached":2,.*"sections_reloaded":1' $tmp/cached.json; then
+    pass "link -c reloads only the changed section"
+else
+    fail "link -c reloads only the changed section"
+    cat $tmp/cached.json
+fi
+
+# nothing changed: nothing reloaded, same image
+$bin link -q -i $cabc -a 4000 -o $tmp/cached.out -c $tmp/cache --stats=json > $tmp/cached.json
+check "link -c unchanged relink == full link" $tmp/fresh.out $tmp/cached.out
+if grep -q '"objects_cached":3,.*"sections_reloaded":0' $tmp/cached.json; then
+    pass "link -c reloads nothing when nothing changed"
+else
+    fail "link -c reloads nothing when nothing changed"
+    cat $tmp/cached.json
+fi
+
+# the load address parses like a hex number, prefix or not, and nothing else
+$bin link -q -i $abc -a 0x4000 -o $tmp/abc_0x.out
+check "link -a 0x4000 == -a 4000" $tmp/abc.out $tmp/abc_0x.out
+rejects "link -a 40zz is rejected" $bin link -q -i $abc -a 40zz -o $tmp/bad.out
+
+# --- run: the vm report, without the timing and the colors ---
+report() { sed -e 's/\x1b\[[0-9;]*m//g' -E -e 's/\([0-9.]+s, [0-9.]+ MIPS\)/(time)/'; }
+
+# echo.obj copies stdin to stdout (RD/WD) until EOF, then halts
+$bin link -q -i $dir/echo.obj -o $tmp/echo.raw
+printf 'SIC/XE\n' | $bin run $tmp/echo.raw -p 3 | report > $tmp/echo_run.txt
+check "run (raw image)" $dir/echo_run.txt $tmp/echo_run.txt
+
+$bin link -q -i $dir/echo.obj -f seg -o $tmp/echo.seg
+printf 'ab' | $bin run $tmp/echo.seg -p 0 -s 5 | report > $tmp/echo_steps.txt
+check "run -s 5 (seg image)" $dir/echo_steps.txt $tmp/echo_steps.txt
+
+printf '\xff\xff\xff' > $tmp/fault.raw
+rejects "run reports an invalid instruction" $bin run $tmp/fault.raw -p 0
+
+echo
+if [ $failed -ne 0 ]; then
+    echo "$failed check(s) failed"
+    exit 1
+fi
+echo "all checks passed"
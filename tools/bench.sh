@@ -0,0 +1,110 @@
+#!/bin/bash
+# end-to-end throughput of dasm and link over a generated corpus (tools/objgen.cpp).
+#
+#   ./build.sh bench            (builds bin/ysicxe + bin/objgen, then runs this)
+#   tools/bench.sh [size] [files]
+#
+# size is the object code per file (k/m suffix, default 4m), files the corpus size
+# (default 8). every timing is the best of BENCH_RUNS runs (default 3).
+# the corpus and the outputs go to BENCH_DIR (default bench/), inputs are reused
+# when they are already there with the same parameters.
+
+set -e
+
+size=${1:-4m}
+files=${2:-8}
+runs=${BENCH_RUNS:-3}
+dir=${BENCH_DIR:-bench}
+bin=${YSICXE:-bin/ysicxe}
+gen=${OBJGEN:-bin/objgen}
+
+sections=4 # per linked file
+
+corpus=$dir/corpus-$size-$files
+out=$dir/out
+mkdir -p $corpus/dasm $corpus/link $out
+
+# --- corpus ---
+# dasm: one control section per file. link: files that reference each other
+if [ ! -f $corpus/done ]; then
+    echo "generating corpus in $corpus ..."
+    for ((i = 0; i < files; i++)); do
+        $gen --id $i --files $files --size $size --seed $i -o $corpus/dasm/d$i.obj
+        $gen --id $i --files $files --size $size --sections $sections --defs 32 --refs 16 \
+             --seed $((i + 1000)) -o $corpus/link/l$i.obj
+    done
+    touch $corpus/done
+fi
+
+# --- helpers ---
+now() { date +%s%N; }
+
+# best wall time (ns) of runs runs of the command
+best_of() {
+    local best=0
+    for ((r = 0; r < runs; r++)); do
+        local start=$(now)
+        "$@" > /dev/null
+        local took=$(($(now) - start))
+        if [ $best -eq 0 ] || [ $took -lt $best ]; then best=$took; fi
+    done
+    echo $best
+}
+
+bytes_of() { cat "$@" | wc -c; }
+lines_of() { cat "$@" | wc -l; }
+
+# name, ns, input bytes, lines (0 = no lines/s column)
+report() {
+    awk -v name="$1" -v ns="$2" -v bytes="$3" -v lines="$4" 'BEGIN {
+        secs = ns / 1e9
+        printf "%-28s %9.3f s %9.1f MB/s", name, secs, bytes / 1048576 / secs
+        if (lines > 0) printf " %12.0f lines/s", lines / secs
+        printf "\n"
+    }'
+}
+
+dasm_in=$(bytes_of $corpus/dasm/*.obj)
+link_in=$(bytes_of $corpus/link/*.obj)
+link_records=$(lines_of $corpus/link/*.obj)
+
+echo "corpus: $files files x $size of code ($((dasm_in / 1048576)) MB dasm, $((link_in / 1048576)) MB link input), best of $runs"
+echo
+
+# --- dasm ---
+dasm_one() {
+    for f in $corpus/dasm/*.obj; do
+        $bin dasm -q $f -o $out/$(basename $f .obj).asm -s $out/$(basename $f .obj).sym
+    done
+}
+
+t=$(best_of dasm_one)
+lines=$(lines_of $out/d*.asm)
+report "dasm (one file at a time)" $t $dasm_in $lines
+
+t=$(best_of $bin dasm -q --batch $corpus/dasm --out-dir $out -j 0)
+report "dasm --batch -j 0" $t $dasm_in $lines
+
+t=$(best_of $bin dasm -q $corpus/dasm/d0.obj -o $out/d0.asm -s $out/d0.sym -n 0)
+report "dasm -n 0 (d0.obj)" $t $(bytes_of $corpus/dasm/d0.obj) $(lines_of $out/d0.asm)
+
+t=$(best_of $bin dasm -q $corpus/dasm/d0.obj -o $out/d0.asm -s $out/d0.sym -r)
+report "dasm -r (d0.obj)" $t $(bytes_of $corpus/dasm/d0.obj) $(lines_of $out/d0.asm)
+
+# --- link (lines/s = records/s) ---
+inputs=$(ls $corpus/link/*.obj | tr '\n' ',')
+inputs=${inputs%,}
+
+t=$(best_of $bin link -q -i $inputs -o $out/link.out)
+report "link" $t $link_in $link_records
+
+t=$(best_of $bin link -q -i $inputs -o $out/link.out -n 0)
+report "link -n 0" $t $link_in $link_records
+
+t=$(best_of $bin link -q -i $inputs -o $out/link.out -m)
+report "link -m" $t $link_in $link_records
+
+rm -rf $out/cache
+$bin link -q -i $inputs -o $out/link.out -c $out/cache > /dev/null
+t=$(best_of $bin link -q -i $inputs -o $out/link.out -c $out/cache)
+report "link -c (nothing changed)" $t $link_in $link_records
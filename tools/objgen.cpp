@@ -0,0 +1,410 @@
+// objgen: synthetic SIC/XE object files for benchmarking (see tools/bench.sh)
+//
+//   objgen [options] -o <file.obj>
+//
+// every file is one piece of a corpus of --files files that link together: file --id k
+// defines its symbols with names built from (k, section, index), and R/M records only
+// refer to names that some file of the corpus defines.
+
+#include "../src/core/defines.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace {
+
+struct gen_opcode {
+    u8 opcode;
+    u8 format;
+};
+
+// the instruction set, split by format
+constexpr gen_opcode all_opcodes[] = {
+#define SIC_OPCODE(name, opc, fmt) {opc, fmt},
+#include "../src/dasm/opcodes.def"
+#undef SIC_OPCODE
+};
+
+struct options {
+    string output;
+    u32 id = 0;            // this file's index in the corpus
+    u32 files = 1;         // corpus size (R/M records refer to symbols of files [0, files))
+    u64 size = 1 << 20;    // bytes of object code, all sections together
+    u32 sections = 1;      // control sections in the file
+    u32 fmt1 = 2;          // instruction mix (relative weights of format 1 / 2 / 3+4)
+    u32 fmt2 = 18;
+    u32 fmt3 = 80;
+    u32 fmt4 = 10;         // % of format 3/4 instructions that are extended
+    u32 data = 5;          // % of items that are data words
+    u32 gaps = 5;          // % of every section left as RESW/RESB (no T record)
+    u32 defs = 8;          // D symbols per section
+    u32 refs = 4;          // R symbols per section
+    i64 mods = -1;         // M records per section, -1 = one per relocatable field
+    u64 seed = 1;
+};
+
+// one instruction or data word of a section
+struct item {
+    u32 addr;
+    u8 len;
+    u8 bytes[4];
+};
+
+// a field an M record can patch
+struct mod_site {
+    u32 addr;
+    u8 len_nibbles;
+};
+
+const char *usage =
+    "usage: objgen [options] -o <file.obj>\n"
+    "  -o <file>        output object file\n"
+    "  --id <n>         index of this file in the corpus [0]\n"
+    "  --files <n>      files in the corpus, R/M records refer to all of them [1]\n"
+    "  --size <bytes>   object code bytes in the file (k/m suffix) [1m]\n"
+    "  --sections <n>   control sections in the file (max 36) [1]\n"
+    "  --mix <a,b,c>    weights of format 1, 2 and 3/4 instructions [2,18,80]\n"
+    "  --fmt4 <pct>     extended (format 4) share of format 3/4 instructions [10]\n"
+    "  --data <pct>     data words between the instructions [5]\n"
+    "  --gaps <pct>     reserved (RESW/RESB) part of every section [5]\n"
+    "  --defs <n>       D symbols per section (max 1296) [8]\n"
+    "  --refs <n>       R symbols per section [4]\n"
+    "  --mods <n>       M records per section [one per relocatable field]\n"
+    "  --seed <n>       random seed [1]\n";
+
+[[noreturn]] void fail(const string &msg) {
+    std::cerr << "objgen: " << msg << "\n" << usage;
+    exit(1);
+}
+
+u64 parse_num(const string &flag, const string &val) {
+    u64 num = 0;
+    auto res = std::from_chars(val.data(), val.data() + val.size(), num);
+
+    string rest(res.ptr, val.data() + val.size());
+    if(res.ec != std::errc() || (rest != "" && rest != "k" && rest != "m")) {
+        fail("invalid value for " + flag + ": '" + val + "'");
+    }
+
+    if(rest == "k") num <<= 10;
+    if(rest == "m") num <<= 20;
+    return num;
+}
+
+options parse_args(i32 argc, char *argv[]) {
+    options opt;
+
+    for(i32 i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if(flag == "-h" || flag == "--help") {
+            std::cout << usage;
+            exit(0);
+        }
+
+        if(i + 1 >= argc) fail("missing value for " + flag);
+        string val = argv[++i];
+
+        if(flag == "-o")              opt.output = val;
+        else if(flag == "--id")       opt.id = parse_num(flag, val);
+        else if(flag == "--files")    opt.files = parse_num(flag, val);
+        else if(flag == "--size")     opt.size = parse_num(flag, val);
+        else if(flag == "--sections") opt.sections = parse_num(flag, val);
+        else if(flag == "--fmt4")     opt.fmt4 = parse_num(flag, val);
+        else if(flag == "--data")     opt.data = parse_num(flag, val);
+        else if(flag == "--gaps")     opt.gaps = parse_num(flag, val);
+        else if(flag == "--defs")     opt.defs = parse_num(flag, val);
+        else if(flag == "--refs")     opt.refs = parse_num(flag, val);
+        else if(flag == "--mods")     opt.mods = parse_num(flag, val);
+        else if(flag == "--seed")     opt.seed = parse_num(flag, val);
+        else if(flag == "--mix") {
+            u32 *weights[] = {&opt.fmt1, &opt.fmt2, &opt.fmt3};
+            stringstream ss(val);
+            string part;
+            for(u32 *w : weights) {
+                if(!getline(ss, part, ',')) fail("--mix needs three weights");
+                *w = parse_num(flag, part);
+            }
+        }
+        else fail("unknown option " + flag);
+    }
+
+    if(opt.output.empty()) fail("no output file (-o)");
+    if(opt.files == 0 || opt.files > 1296 || opt.id >= opt.files) fail("--id must be below --files (max 1296)");
+    if(opt.sections == 0 || opt.sections > 36) fail("--sections must be 1..36");
+    if(opt.defs > 1296) fail("--defs must be at most 1296");
+    if(opt.fmt1 + opt.fmt2 + opt.fmt3 == 0) fail("--mix can't be all zero");
+    if(opt.fmt4 > 100 || opt.data > 100 || opt.gaps > 90) fail("percentages out of range");
+
+    // a section has to fit the 6 digit addresses of the records
+    if(opt.size / opt.sections >= 0xFFFFFF) fail("--size too large for that many sections");
+
+    return opt;
+}
+
+// --- names (6 chars, unique across the corpus) ---
+void base36(char *out, u32 val, i32 width) {
+    for(i32 i = width - 1; i >= 0; i--) {
+        out[i] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[val % 36];
+        val /= 36;
+    }
+}
+
+string section_name(u32 file, u32 sec) {
+    char name[7] = "C";
+    base36(name + 1, file, 3);
+    base36(name + 4, sec, 2);
+    return name;
+}
+
+string symbol_name(u32 file, u32 sec, u32 def) {
+    char name[7] = "S";
+    base36(name + 1, file, 2);
+    base36(name + 3, sec, 1);
+    base36(name + 4, def, 2);
+    return name;
+}
+
+// --- record text ---
+void put_hex(string &out, u64 val, i32 digits) {
+    char buf[16];
+    for(i32 i = digits - 1; i >= 0; i--) {
+        buf[i] = "0123456789ABCDEF"[val & 0xF];
+        val >>= 4;
+    }
+    out.append(buf, digits);
+}
+
+void put_name(string &out, const string &name) {
+    out += name;
+    out.append(6 - name.size(), ' ');
+}
+
+class generator {
+private:
+    const options &opt;
+    std::mt19937_64 rng;
+
+    vector<gen_opcode> by_format[4];
+    string text; // the whole file
+
+    u32 below(u32 n) { return n ? (u32)(rng() % n) : 0; }
+    bool chance(u32 pct) { return below(100) < pct; }
+
+    // one format 1/2/3/4 instruction at addr
+    item make_instruction(u32 addr, u32 sec_len, vector<mod_site> &sites);
+    void emit_section(u32 sec);
+
+public:
+    generator(const options &opt) : opt{opt}, rng{opt.seed * 1000003 + opt.id} {
+        for(const gen_opcode &op : all_opcodes) by_format[op.format].push_back(op);
+    }
+
+    const string &run();
+};
+
+item generator::make_instruction(u32 addr, u32 sec_len, vector<mod_site> &sites) {
+    item it{addr, 0, {}};
+
+    u32 pick = below(opt.fmt1 + opt.fmt2 + opt.fmt3);
+    u32 format = pick < opt.fmt1 ? 1 : (pick < opt.fmt1 + opt.fmt2 ? 2 : 3);
+    if(format == 3 && chance(opt.fmt4)) format = 4;
+
+    const vector<gen_opcode> &ops = by_format[format == 4 ? 3 : format];
+    u8 opcode = ops[below(ops.size())].opcode;
+
+    // registers a fmt 2 instruction may name: A X L B S T F, PC SW
+    static const u8 regs[] = {0, 1, 2, 3, 4, 5, 6, 8, 9};
+
+    switch(format) {
+        case 1:
+            it.len = 1;
+            it.bytes[0] = opcode;
+            break;
+
+        case 2:
+            it.len = 2;
+            it.bytes[0] = opcode;
+            it.bytes[1] = (regs[below(9)] << 4) | regs[below(9)];
+            break;
+
+        case 3: {
+            // mostly simple addressing, some immediate / indirect; pc relative, base or direct
+            u8 ni = chance(80) ? 3 : (chance(50) ? 1 : 2);
+            u8 xbpe = chance(10) ? 0x8 : 0;
+            u32 kind = below(100);
+            if(kind < 70) xbpe |= 0x2;
+            else if(kind < 85) xbpe |= 0x4;
+
+            u32 disp = below(0x1000);
+
+            it.len = 3;
+            it.bytes[0] = opcode | ni;
+            it.bytes[1] = (xbpe << 4) | (disp >> 8);
+            it.bytes[2] = disp & 0xFF;
+            break;
+        }
+
+        case 4: {
+            // a section relative address, relocated by an M record
+            u8 ni = chance(90) ? 3 : 1;
+            u32 target = below(sec_len) & 0xFFFFF;
+
+            it.len = 4;
+            it.bytes[0] = opcode | ni;
+            it.bytes[1] = (chance(10) ? 0x80 : 0) | 0x10 | (target >> 16);
+            it.bytes[2] = (target >> 8) & 0xFF;
+            it.bytes[3] = target & 0xFF;
+
+            sites.push_back({addr + 1, 5});
+            break;
+        }
+    }
+
+    return it;
+}
+
+void generator::emit_section(u32 sec) {
+    u32 sec_len = std::max<u64>(opt.size / opt.sections, 1);
+    string name = section_name(opt.id, sec);
+
+    // --- body: instructions and data words, with reserved gaps in between ---
+    vector<item> items;
+    vector<mod_site> sites;
+
+    // gaps average 96 bytes, items ~3: start one often enough to hit the --gaps share
+    u32 gap_per_mille = opt.gaps ? (u32)(1000.0 * 3 * opt.gaps / (96.0 * (100 - opt.gaps))) : 0;
+
+    u32 addr = 0;
+    while(addr < sec_len) {
+        if(gap_per_mille && below(1000) < gap_per_mille) {
+            addr += chance(50) ? 3 * (1 + below(64)) : 1 + below(192); // RESW or RESB
+            continue;
+        }
+
+        item it;
+        if(chance(opt.data)) {
+            it = {addr, 3, {}};
+            for(u32 i = 0; i < 3; i++) it.bytes[i] = below(256);
+            sites.push_back({addr, 6});
+        }
+        else {
+            it = make_instruction(addr, sec_len, sites);
+        }
+
+        // nothing hangs over the end of the section
+        if(addr + it.len > sec_len) {
+            if(!sites.empty() && sites.back().addr >= addr) sites.pop_back();
+            break;
+        }
+
+        items.push_back(it);
+        addr += it.len;
+    }
+
+    // --- H ---
+    text += "H^";
+    put_name(text, name);
+    text += "^000000^";
+    put_hex(text, sec_len, 6);
+    text += "\n";
+
+    // --- D: symbols at random places in the section, 6 per record ---
+    for(u32 i = 0; i < opt.defs; i++) {
+        if(i % 6 == 0) text += i ? "\nD" : "D";
+
+        text += "^";
+        put_name(text, symbol_name(opt.id, sec, i));
+        text += "^";
+        put_hex(text, below(sec_len), 6);
+    }
+    if(opt.defs) text += "\n";
+
+    // --- R: symbols of other sections of the corpus, 12 per record ---
+    vector<string> refs;
+    if(opt.defs) {
+        for(u32 i = 0; i < opt.refs * 4 && refs.size() < opt.refs; i++) {
+            u32 file = below(opt.files);
+            u32 other = below(opt.sections);
+            if(file == opt.id && other == sec) continue;
+
+            string ref = symbol_name(file, other, below(opt.defs));
+            if(std::find(refs.begin(), refs.end(), ref) == refs.end()) refs.push_back(ref);
+        }
+    }
+
+    for(usize i = 0; i < refs.size(); i++) {
+        if(i % 12 == 0) text += i ? "\nR" : "R";
+        text += "^";
+        put_name(text, refs[i]);
+    }
+    if(!refs.empty()) text += "\n";
+
+    // --- T: up to 30 bytes of whole items, split at the gaps ---
+    for(usize i = 0; i < items.size();) {
+        usize first = i;
+        u32 start = items[i].addr;
+        u32 len = 0;
+
+        while(i < items.size() && items[i].addr == start + len && len + items[i].len <= 0x1E) {
+            len += items[i].len;
+            i++;
+        }
+
+        text += "T^";
+        put_hex(text, start, 6);
+        text += "^";
+        put_hex(text, len, 2);
+
+        for(usize j = first; j < i; j++) {
+            text += "^";
+            for(u32 b = 0; b < items[j].len; b++) put_hex(text, items[j].bytes[b], 2);
+        }
+        text += "\n";
+    }
+
+    // --- M: a sample of the relocatable fields, own section or an external symbol ---
+    usize count = opt.mods < 0 ? sites.size() : std::min<usize>(opt.mods, sites.size());
+    for(usize i = 0; i < count; i++) {
+        std::swap(sites[i], sites[i + below(sites.size() - i)]);
+    }
+    std::sort(sites.begin(), sites.begin() + count, [](const mod_site &a, const mod_site &b) { return a.addr < b.addr; });
+
+    for(usize i = 0; i < count; i++) {
+        text += "M^";
+        put_hex(text, sites[i].addr, 6);
+        text += sites[i].len_nibbles == 5 ? "^05^+" : "^06^+";
+        text += refs.empty() || chance(50) ? name : refs[below(refs.size())];
+        text += "\n";
+    }
+
+    // --- E: the first section of the corpus is the main one ---
+    text += opt.id == 0 && sec == 0 ? "E^000000\n" : "E\n";
+}
+
+const string &generator::run() {
+    text.reserve(opt.size * 2 + opt.size / 10);
+    for(u32 sec = 0; sec < opt.sections; sec++) emit_section(sec);
+    return text;
+}
+
+} // namespace
+
+i32 main(i32 argc, char *argv[]) {
+    options opt = parse_args(argc, argv);
+
+    generator gen(opt);
+    const string &text = gen.run();
+
+    ofstream out(opt.output, std::ios::binary);
+    out.write(text.data(), text.size());
+
+    if(!out) {
+        std::cerr << "objgen: couldn't write " << opt.output << "\n";
+        return 1;
+    }
+
+    return 0;
+}